@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Model.h"
+#include <algorithm>
+#include <functional>
+#include <span>
+#include <vector>
+
+// Running totals of the levels of one order-book snapshot, from the best
+// level outwards, so that what a market order would get by walking the book
+// is a binary search rather than a walk.
+class BookDepth
+{
+public:
+    struct Fill
+    {
+        double quantity; // filled, less than asked when the book runs out
+        double notional; // money paid or received for it, before fees
+        double price; // volume-weighted, or the best level when nothing filled
+    };
+
+private:
+    struct Side
+    {
+        std::vector<double> prices; // best first
+        std::vector<double> quantities; // sum of the levels up to and including this one
+        std::vector<double> notionals;
+
+        // levels as stored in an OrderBook, best at the back.
+        void assign(std::span<const Order> levels){
+            std::size_t n = levels.size();
+            prices.resize(n);
+            quantities.resize(n);
+            notionals.resize(n);
+            double quantity = 0, notional = 0;
+            for(std::size_t k = 0; k < n; k++){
+                const Order &level = levels[n-1-k];
+                quantity += level.quantity;
+                notional += level.quantity * level.price;
+                prices[k] = level.price;
+                quantities[k] = quantity;
+                notionals[k] = notional;
+            }
+        }
+
+        // Fill of whatever amount makes totals reach amount. amount is a
+        // quantity or a notional, depending on which totals are given.
+        Fill walk(const std::vector<double> &totals, double amount, bool byQuantity) const {
+            std::size_t k = std::lower_bound(totals.begin(), totals.end(), amount) - totals.begin();
+            if(k == totals.size())
+                return Fill{quantities.back(), notionals.back(), notionals.back() / quantities.back()};
+            double quantity = k ? quantities[k-1] : 0;
+            double notional = k ? notionals[k-1] : 0;
+            if(byQuantity){
+                notional += (amount - quantity) * prices[k];
+                quantity = amount;
+            }else{
+                quantity += (amount - notional) / prices[k];
+                notional = amount;
+            }
+            return Fill{quantity, notional, quantity > 0 ? notional / quantity : prices[0]};
+        }
+    };
+
+    long long lastUpdateId;
+    TimePoint E;
+    bool valid;
+    Side bids;
+    Side asks;
+
+public:
+    BookDepth() : lastUpdateId{0}, E{TimePoint::zero()}, valid{false} {}
+
+    bool holds(long long lastUpdateId, TimePoint E) const {
+        return valid && this->lastUpdateId == lastUpdateId && this->E == E;
+    }
+
+    void assign(long long lastUpdateId, TimePoint E, std::span<const Order> bids, std::span<const Order> asks){
+        this->lastUpdateId = lastUpdateId;
+        this->E = E;
+        this->bids.assign(bids);
+        this->asks.assign(asks);
+        valid = true;
+    }
+
+    void clear(){ valid = false; }
+
+    bool hasBids() const { return !bids.prices.empty(); }
+    bool hasAsks() const { return !asks.prices.empty(); }
+
+    // Quantity resting at exactly price on side, 0 if there is no such level.
+    double levelQuantity(ActionType side, double price) const {
+        const Side &levels = side == BUY ? bids : asks;
+        auto level = side == BUY
+            ? std::lower_bound(levels.prices.begin(), levels.prices.end(), price, std::greater<double>())
+            : std::lower_bound(levels.prices.begin(), levels.prices.end(), price);
+        if(level == levels.prices.end() || *level != price)
+            return 0;
+        std::size_t k = level - levels.prices.begin();
+        return levels.quantities[k] - (k ? levels.quantities[k-1] : 0);
+    }
+
+    // Buying quantity from the asks. Needs hasAsks.
+    Fill buy(double quantity) const { return asks.walk(asks.quantities, quantity, true); }
+    // Buying from the asks for at most money. Needs hasAsks.
+    Fill buyFor(double money) const { return asks.walk(asks.notionals, money, false); }
+    // Selling quantity to the bids. Needs hasBids.
+    Fill sell(double quantity) const { return bids.walk(bids.quantities, quantity, true); }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Fixed-capacity FIFO shared by one producer and one consumer. push blocks
+// while the queue is full, pop blocks while it is empty; after close both
+// return immediately (pop still drains what is left).
+template<typename T>
+class BoundedQueue
+{
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    std::size_t capacity;
+    bool closed;
+
+public:
+    explicit BoundedQueue(std::size_t capacity) :
+    capacity{capacity},
+    closed{false}
+    {
+    }
+
+    bool push(T item){
+        std::unique_lock lock(mutex);
+        notFull.wait(lock, [this](){ return closed || items.size() < capacity; });
+        if(closed)
+            return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    std::optional<T> pop(){
+        std::unique_lock lock(mutex);
+        notEmpty.wait(lock, [this](){ return closed || !items.empty(); });
+        if(items.empty())
+            return std::nullopt;
+        T item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    void close(){
+        std::lock_guard lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
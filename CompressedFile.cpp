@@ -0,0 +1,171 @@
+#include "CompressedFile.h"
+#include <QFile>
+#include <zlib.h>
+#include <zstd.h>
+
+class GzipDecoder : public CompressedFile::Decoder
+{
+    z_stream stream;
+    bool ended;
+
+public:
+    GzipDecoder() :
+    stream{},
+    ended{false}
+    {
+        inflateInit2(&stream, 15 + 32); // accept gzip and zlib headers
+    }
+
+    ~GzipDecoder() override {
+        inflateEnd(&stream);
+    }
+
+    bool decode(const char *&in, const char *inEnd, std::string &out, std::size_t limit) override {
+        std::size_t target = out.size() + limit;
+        do{
+            // A .gz file may hold several members back to back.
+            if(ended && in < inEnd){
+                inflateReset(&stream);
+                ended = false;
+            }
+            if(ended)
+                break;
+            std::size_t offset = out.size();
+            out.resize(target);
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+            stream.avail_in = static_cast<uInt>(inEnd - in);
+            stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+            stream.avail_out = static_cast<uInt>(target - offset);
+            int result = inflate(&stream, Z_NO_FLUSH);
+            in = reinterpret_cast<const char*>(stream.next_in);
+            out.resize(target - stream.avail_out);
+            if(result == Z_STREAM_END)
+                ended = true;
+            else if(result == Z_BUF_ERROR)
+                break;
+            else if(result != Z_OK)
+                return false;
+        }while(in < inEnd && out.size() < target);
+        return true;
+    }
+
+    bool finished() const override { return ended; }
+};
+
+class ZstdDecoder : public CompressedFile::Decoder
+{
+    ZSTD_DStream *stream;
+    bool ended;
+
+public:
+    ZstdDecoder() :
+    stream{ZSTD_createDStream()},
+    ended{false}
+    {
+        ZSTD_initDStream(stream);
+    }
+
+    ~ZstdDecoder() override {
+        ZSTD_freeDStream(stream);
+    }
+
+    bool decode(const char *&in, const char *inEnd, std::string &out, std::size_t limit) override {
+        std::size_t target = out.size() + limit;
+        ZSTD_inBuffer input{in, static_cast<std::size_t>(inEnd - in), 0};
+        do{
+            std::size_t offset = out.size();
+            out.resize(target);
+            ZSTD_outBuffer output{out.data() + offset, target - offset, 0};
+            std::size_t consumed = input.pos;
+            std::size_t result = ZSTD_decompressStream(stream, &output, &input);
+            out.resize(offset + output.pos);
+            if(ZSTD_isError(result)){
+                in += input.pos;
+                return false;
+            }
+            // 0 once a frame is decoded and flushed. A call that did nothing
+            // says nothing about the frame.
+            if(input.pos != consumed || output.pos != 0)
+                ended = result == 0;
+        }while(input.pos < input.size && out.size() < target);
+        in += input.pos;
+        return true;
+    }
+
+    bool finished() const override { return ended; }
+};
+
+CompressedFile::Format CompressedFile::format(const std::string &path){
+    if(path.ends_with(".gz"))
+        return GZIP;
+    if(path.ends_with(".zst"))
+        return ZSTD;
+    return NONE;
+}
+
+CompressedFile::CompressedFile(const std::string &path) :
+compressed{queueCapacity},
+inputPos{nullptr},
+failed{false}
+{
+    if(format(path) == ZSTD)
+        decoder = std::make_unique<ZstdDecoder>();
+    else
+        decoder = std::make_unique<GzipDecoder>();
+    inputPos = input.data();
+
+    reader = std::jthread([this, path](){
+        QFile file(QString::fromStdString(path));
+        if(file.open(QIODevice::ReadOnly)){
+            for(;;){
+                std::string chunk(readSize, '\0');
+                qint64 read = file.read(chunk.data(), static_cast<qint64>(chunk.size()));
+                if(read <= 0)
+                    break;
+                chunk.resize(static_cast<std::size_t>(read));
+                if(!compressed.push(std::move(chunk)))
+                    break;
+            }
+        }
+        compressed.close();
+    });
+}
+
+CompressedFile::~CompressedFile()
+{
+    compressed.close();
+}
+
+bool CompressedFile::next(std::string &block){
+    block = std::move(carry);
+    carry.clear();
+    while(!failed){
+        bool moreInput = inputPos != input.data() + input.size();
+        if(!moreInput){
+            std::optional<std::string> chunk = compressed.pop();
+            if(chunk){
+                input = std::move(*chunk);
+                inputPos = input.data();
+                moreInput = true;
+            }
+        }
+        // With no input left this only flushes what the decoder still holds.
+        std::size_t before = block.size();
+        std::size_t limit = block.size() < blockSize ? blockSize - block.size() : blockSize;
+        if(!decoder->decode(inputPos, input.data() + input.size(), block, limit))
+            failed = true;
+        if(block.size() >= blockSize){
+            std::size_t lastLine = block.rfind('\n');
+            if(lastLine != std::string::npos){
+                carry.assign(block, lastLine + 1);
+                block.resize(lastLine + 1);
+                return true;
+            }
+        }
+        if(!moreInput && block.size() == before){
+            failed = failed || !decoder->finished();
+            break;
+        }
+    }
+    return !block.empty();
+}
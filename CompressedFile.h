@@ -0,0 +1,59 @@
+#pragma once
+
+#include "BoundedQueue.h"
+#include <memory>
+#include <string>
+#include <thread>
+
+// Decompresses a gzip or zstd file into memory, one block at a time. A reader
+// thread keeps the next compressed chunks queued while the caller
+// decompresses, so disk reads and decompression overlap. Every block handed
+// out ends on a newline, which lets each block be parsed on its own.
+class CompressedFile
+{
+public:
+    enum Format {
+        NONE,
+        GZIP,
+        ZSTD
+    };
+
+    static constexpr std::size_t readSize = 1 << 20;
+    static constexpr std::size_t blockSize = 8 << 20;
+    static constexpr std::size_t queueCapacity = 4;
+
+    // Decided by the file extension (.gz or .zst).
+    static Format format(const std::string &path);
+
+    class Decoder
+    {
+    public:
+        virtual ~Decoder() = default;
+        // Consumes input from in and appends to out until in is used up or out
+        // has grown by at least limit bytes. Returns false on corrupt data.
+        virtual bool decode(const char *&in, const char *inEnd, std::string &out, std::size_t limit) = 0;
+        // True when the data decoded so far ends where a stream ends, so that
+        // running out of input there is not a truncation.
+        virtual bool finished() const = 0;
+    };
+
+private:
+    std::unique_ptr<Decoder> decoder;
+    BoundedQueue<std::string> compressed;
+    std::string input;
+    const char *inputPos;
+    std::string carry;
+    bool failed;
+    std::jthread reader;
+
+public:
+    explicit CompressedFile(const std::string &path);
+    ~CompressedFile();
+
+    // Replaces block with the next decompressed block. Returns false once all
+    // data has been returned.
+    bool next(std::string &block);
+
+    // True when the data was corrupt or truncated.
+    bool hasFailed() const { return failed; }
+};
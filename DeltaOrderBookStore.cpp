@@ -0,0 +1,105 @@
+#include "DeltaOrderBookStore.h"
+
+// Sides are kept in the order MarketDataParser::sortLevels leaves them.
+static bool asksBefore(const Order &a, const Order &b){ return a.price > b.price; }
+static bool bidsBefore(const Order &a, const Order &b){ return a.price < b.price; }
+
+DeltaOrderBookStore::DeltaOrderBookStore() :
+cursor{noSnapshot}
+{
+}
+
+template<typename Before>
+void DeltaOrderBookStore::appendChanges(const std::vector<Order> &from, const std::vector<Order> &to, Before before){
+    auto f = from.begin();
+    auto t = to.begin();
+    while(f != from.end() || t != to.end()){
+        if(t == to.end() || (f != from.end() && before(*f, *t))){
+            levels.push_back(Order{f->price, -1});
+            ++f;
+        }else if(f == from.end() || before(*t, *f)){
+            levels.push_back(*t);
+            ++t;
+        }else{
+            if(f->quantity != t->quantity)
+                levels.push_back(*t);
+            ++f;
+            ++t;
+        }
+    }
+}
+
+template<typename Before>
+void DeltaOrderBookStore::applyChanges(std::vector<Order> &side, const Order *changes, std::size_t count, Before before){
+    scratch.clear();
+    auto s = side.begin();
+    const Order *c = changes;
+    const Order *end = changes + count;
+    while(s != side.end() || c != end){
+        if(c == end || (s != side.end() && before(*s, *c))){
+            scratch.push_back(*s);
+            ++s;
+        }else{
+            if(c->quantity >= 0)
+                scratch.push_back(*c);
+            if(s != side.end() && !before(*c, *s))
+                ++s;
+            ++c;
+        }
+    }
+    side.swap(scratch);
+}
+
+void DeltaOrderBookStore::append(const OrderBook &orderBook){
+    Entry entry{orderBook.lastUpdateId, orderBook.E, levels.size(), 0, 0};
+    if(entries.size() % keyframeInterval == 0){
+        levels.insert(levels.end(), orderBook.bids.begin(), orderBook.bids.end());
+        entry.bids = static_cast<std::uint32_t>(orderBook.bids.size());
+        levels.insert(levels.end(), orderBook.asks.begin(), orderBook.asks.end());
+        entry.asks = static_cast<std::uint32_t>(orderBook.asks.size());
+    }else{
+        appendChanges(previous.bids, orderBook.bids, bidsBefore);
+        entry.bids = static_cast<std::uint32_t>(levels.size() - entry.offset);
+        appendChanges(previous.asks, orderBook.asks, asksBefore);
+        entry.asks = static_cast<std::uint32_t>(levels.size() - entry.offset - entry.bids);
+    }
+    entries.push_back(entry);
+    previous.bids.assign(orderBook.bids.begin(), orderBook.bids.end());
+    previous.asks.assign(orderBook.asks.begin(), orderBook.asks.end());
+}
+
+void DeltaOrderBookStore::loadKeyframe(std::size_t i){
+    const Entry &entry = entries[i];
+    const Order *bids = levels.data() + entry.offset;
+    current.bids.assign(bids, bids + entry.bids);
+    current.asks.assign(bids + entry.bids, bids + entry.bids + entry.asks);
+    cursor = i;
+}
+
+void DeltaOrderBookStore::applyDelta(std::size_t i){
+    const Entry &entry = entries[i];
+    const Order *bids = levels.data() + entry.offset;
+    applyChanges(current.bids, bids, entry.bids, bidsBefore);
+    applyChanges(current.asks, bids + entry.bids, entry.asks, asksBefore);
+    cursor = i;
+}
+
+const OrderBook &DeltaOrderBookStore::at(std::size_t i){
+    std::size_t keyframe = i - i % keyframeInterval;
+    if(cursor == noSnapshot || cursor > i || cursor < keyframe)
+        loadKeyframe(keyframe);
+    while(cursor < i)
+        applyDelta(cursor + 1);
+    current.lastUpdateId = entries[i].lastUpdateId;
+    current.E = entries[i].E;
+    return current;
+}
+
+void DeltaOrderBookStore::shrinkToFit(){
+    entries.shrink_to_fit();
+    levels.shrink_to_fit();
+}
+
+std::size_t DeltaOrderBookStore::memoryUsage() const {
+    return entries.capacity() * sizeof(Entry) + levels.capacity() * sizeof(Order);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Model.h"
+#include "RevivalGlobal.h"
+#include <cstdint>
+#include <vector>
+
+// Order-book history stored as a full keyframe every keyframeInterval
+// snapshots and, in between, only the levels that changed since the previous
+// snapshot. Snapshots are rebuilt on demand into one reusable OrderBook, so
+// walking them in order costs one small delta per step.
+class REVIVAL_API DeltaOrderBookStore
+{
+public:
+    static constexpr std::size_t keyframeInterval = 64;
+
+private:
+    // For a keyframe bids/asks count full levels, otherwise changes. A change
+    // with a negative quantity removes the level at that price.
+    struct Entry
+    {
+        long long lastUpdateId;
+        TimePoint E;
+        std::size_t offset;
+        std::uint32_t bids;
+        std::uint32_t asks;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Order> levels;
+
+    static constexpr std::size_t noSnapshot = static_cast<std::size_t>(-1);
+
+    OrderBook previous;
+    OrderBook current;
+    std::size_t cursor; // snapshot held in current
+    std::vector<Order> scratch;
+
+    template<typename Before>
+    void appendChanges(const std::vector<Order> &from, const std::vector<Order> &to, Before before);
+    template<typename Before>
+    void applyChanges(std::vector<Order> &side, const Order *changes, std::size_t count, Before before);
+    void loadKeyframe(std::size_t i);
+    void applyDelta(std::size_t i);
+
+public:
+    DeltaOrderBookStore();
+
+    void append(const OrderBook &orderBook);
+    std::size_t size() const { return entries.size(); }
+
+    // Valid until the next call to at.
+    const OrderBook &at(std::size_t i);
+
+    void shrinkToFit();
+    std::size_t memoryUsage() const;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <QFile>
+
+// Read-only memory mapping of a whole file. The bytes stay valid for as long
+// as the MappedFile is alive, so parsers can work on them without copying.
+class MappedFile
+{
+    QFile file;
+    uchar *data;
+    qint64 length;
+
+public:
+    MappedFile(const std::string &path) :
+    file{QString::fromStdString(path)},
+    data{nullptr},
+    length{0}
+    {
+        if(!file.open(QIODevice::ReadOnly))
+            return;
+        length = file.size();
+        if(length > 0)
+            data = file.map(0, length);
+        if(data == nullptr)
+            length = 0;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile(){
+        if(data != nullptr)
+            file.unmap(data);
+    }
+
+    bool isMapped() const { return data != nullptr; }
+
+    std::string_view view() const {
+        return std::string_view(reinterpret_cast<const char*>(data), static_cast<std::size_t>(length));
+    }
+};
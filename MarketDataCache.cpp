@@ -0,0 +1,196 @@
+#include "MarketDataCache.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <QFileInfo>
+#include <QSaveFile>
+
+static constexpr char cacheMagic[8] = {'R', 'V', 'C', 'A', 'C', 'H', 'E', '\0'};
+
+static MarketDataCache::CacheHeader makeHeader(const std::string &sourceFile, MarketDataCache::Kind kind, std::uint64_t count, std::uint64_t levelCount){
+    QFileInfo source(QString::fromStdString(sourceFile));
+    MarketDataCache::CacheHeader header{};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = MarketDataCache::version;
+    header.kind = kind;
+    header.sourceSize = source.size();
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.count = count;
+    header.levelCount = levelCount;
+    return header;
+}
+
+// Returns the header of an up to date cache, or nullptr.
+static const MarketDataCache::CacheHeader *validHeader(const std::string &sourceFile, const MappedFile &cache, MarketDataCache::Kind kind){
+    std::string_view data = cache.view();
+    if(data.size() < sizeof(MarketDataCache::CacheHeader))
+        return nullptr;
+    const auto *header = reinterpret_cast<const MarketDataCache::CacheHeader*>(data.data());
+    MarketDataCache::CacheHeader expected = makeHeader(sourceFile, kind, header->count, header->levelCount);
+    if(std::memcmp(header, &expected, sizeof(expected)) != 0)
+        return nullptr;
+    // both kinds have four 8-byte columns; trades add a byte column
+    std::uint64_t rowSize = kind == MarketDataCache::TRADES ? 4 * 8 + 1 : 4 * 8;
+    if(header->count > data.size() / rowSize || header->levelCount > data.size() / sizeof(Order))
+        return nullptr;
+    std::uint64_t size = sizeof(*header) + header->count * rowSize + header->levelCount * sizeof(Order);
+    if(data.size() != size)
+        return nullptr;
+    // The books' level counts have to add up to the levels stored, or the
+    // spans built from them would run past the end of the file.
+    if(kind == MarketDataCache::ORDER_BOOKS){
+        const auto *levelCounts = reinterpret_cast<const std::uint64_t*>(header + 1) + 2 * header->count;
+        std::uint64_t levels = 0;
+        for(std::uint64_t i = 0; i < 2 * header->count; i++){
+            if(levelCounts[i] > header->levelCount - levels)
+                return nullptr;
+            levels += levelCounts[i];
+        }
+        if(levels != header->levelCount)
+            return nullptr;
+    }
+    return header;
+}
+
+template<typename T, typename Rows, typename Field>
+static bool writeColumn(QSaveFile &file, const Rows &rows, Field field){
+    std::vector<T> column;
+    column.reserve(rows.size());
+    for(std::size_t i = 0; i < rows.size(); i++)
+        column.push_back(static_cast<T>(field(rows[i])));
+    qint64 bytes = static_cast<qint64>(column.size() * sizeof(T));
+    return file.write(reinterpret_cast<const char*>(column.data()), bytes) == bytes;
+}
+
+std::string MarketDataCache::cachePath(const std::string &sourceFile){
+    return sourceFile + ".rvcache";
+}
+
+// The columns of the file are the columns of TradeColumns, so each is
+// appended in one go.
+bool MarketDataCache::read(const std::string &sourceFile, TradeColumns &trades){
+    MappedFile cache(cachePath(sourceFile));
+    const CacheHeader *header = validHeader(sourceFile, cache, TRADES);
+    if(header == nullptr)
+        return false;
+    std::size_t count = header->count;
+    const auto *tradeIds = reinterpret_cast<const std::int64_t*>(header + 1);
+    const auto *prices = reinterpret_cast<const double*>(tradeIds + count);
+    const auto *quantities = prices + count;
+    const auto *timestamps = reinterpret_cast<const std::int64_t*>(quantities + count);
+    const auto *buyerMakers = reinterpret_cast<const std::uint8_t*>(timestamps + count);
+
+    trades.reserve(trades.size() + count);
+    trades.tradeIds.insert(trades.tradeIds.end(), tradeIds, tradeIds + count);
+    trades.prices.insert(trades.prices.end(), prices, prices + count);
+    trades.quantities.insert(trades.quantities.end(), quantities, quantities + count);
+    for(std::size_t i = 0; i < count; i++)
+        trades.timestamps.push_back(TimePoint(timestamps[i]));
+    trades.buyerMakers.insert(trades.buyerMakers.end(), buyerMakers, buyerMakers + count);
+    return true;
+}
+
+bool MarketDataCache::read(const std::string &sourceFile, std::vector<OrderBook> &orderBooks){
+    MappedFile cache(cachePath(sourceFile));
+    const CacheHeader *header = validHeader(sourceFile, cache, ORDER_BOOKS);
+    if(header == nullptr)
+        return false;
+    std::size_t count = header->count;
+    const auto *lastUpdateIds = reinterpret_cast<const std::int64_t*>(header + 1);
+    const auto *Es = lastUpdateIds + count;
+    const auto *bidCounts = reinterpret_cast<const std::uint64_t*>(Es + count);
+    const auto *askCounts = bidCounts + count;
+    const auto *levels = reinterpret_cast<const Order*>(askCounts + count);
+
+    std::size_t offset = orderBooks.size();
+    orderBooks.resize(offset + count);
+    for(std::size_t i = 0; i < count; i++){
+        OrderBook &orderBook = orderBooks[offset + i];
+        orderBook.lastUpdateId = lastUpdateIds[i];
+        orderBook.E = TimePoint(Es[i]);
+        orderBook.bids.assign(levels, levels + bidCounts[i]);
+        levels += bidCounts[i];
+        orderBook.asks.assign(levels, levels + askCounts[i]);
+        levels += askCounts[i];
+    }
+    return true;
+}
+
+bool MarketDataCache::read(const std::string &sourceFile, OrderBookArena &orderBooks){
+    MappedFile cache(cachePath(sourceFile));
+    const CacheHeader *header = validHeader(sourceFile, cache, ORDER_BOOKS);
+    if(header == nullptr)
+        return false;
+    std::size_t count = header->count;
+    const auto *lastUpdateIds = reinterpret_cast<const std::int64_t*>(header + 1);
+    const auto *Es = lastUpdateIds + count;
+    const auto *bidCounts = reinterpret_cast<const std::uint64_t*>(Es + count);
+    const auto *askCounts = bidCounts + count;
+    const auto *levels = reinterpret_cast<const Order*>(askCounts + count);
+
+    orderBooks.reserve(count, header->levelCount);
+    for(std::size_t i = 0; i < count; i++){
+        std::span<const Order> bids(levels, bidCounts[i]);
+        std::span<const Order> asks(levels + bidCounts[i], askCounts[i]);
+        orderBooks.append(lastUpdateIds[i], TimePoint(Es[i]), bids, asks);
+        levels += bidCounts[i] + askCounts[i];
+    }
+    return true;
+}
+
+bool MarketDataCache::write(const std::string &sourceFile, const TradeColumns &trades){
+    QSaveFile file(QString::fromStdString(cachePath(sourceFile)));
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    CacheHeader header = makeHeader(sourceFile, TRADES, trades.size(), 0);
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+        && writeColumn<std::int64_t>(file, trades.tradeIds, [](long long tradeId){ return tradeId; })
+        && writeColumn<double>(file, trades.prices, [](double price){ return price; })
+        && writeColumn<double>(file, trades.quantities, [](double quantity){ return quantity; })
+        && writeColumn<std::int64_t>(file, trades.timestamps, [](TimePoint timestamp){ return timestamp.count(); })
+        && writeColumn<std::uint8_t>(file, trades.buyerMakers, [](std::uint8_t isBuyerMaker){ return isBuyerMaker; });
+    return ok && file.commit();
+}
+
+bool MarketDataCache::write(const std::string &sourceFile, const std::vector<OrderBook> &orderBooks){
+    QSaveFile file(QString::fromStdString(cachePath(sourceFile)));
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    std::vector<Order> levels;
+    for(const auto& orderBook : orderBooks){
+        levels.insert(levels.end(), orderBook.bids.begin(), orderBook.bids.end());
+        levels.insert(levels.end(), orderBook.asks.begin(), orderBook.asks.end());
+    }
+    CacheHeader header = makeHeader(sourceFile, ORDER_BOOKS, orderBooks.size(), levels.size());
+    qint64 levelBytes = static_cast<qint64>(levels.size() * sizeof(Order));
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+        && writeColumn<std::int64_t>(file, orderBooks, [](const OrderBook& o){ return o.lastUpdateId; })
+        && writeColumn<std::int64_t>(file, orderBooks, [](const OrderBook& o){ return o.E.count(); })
+        && writeColumn<std::uint64_t>(file, orderBooks, [](const OrderBook& o){ return o.bids.size(); })
+        && writeColumn<std::uint64_t>(file, orderBooks, [](const OrderBook& o){ return o.asks.size(); })
+        && file.write(reinterpret_cast<const char*>(levels.data()), levelBytes) == levelBytes;
+    return ok && file.commit();
+}
+
+bool MarketDataCache::write(const std::string &sourceFile, const OrderBookArena &orderBooks){
+    QSaveFile file(QString::fromStdString(cachePath(sourceFile)));
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    std::size_t levelCount = 0;
+    for(std::size_t i = 0; i < orderBooks.size(); i++)
+        levelCount += orderBooks[i].bids.size() + orderBooks[i].asks.size();
+    CacheHeader header = makeHeader(sourceFile, ORDER_BOOKS, orderBooks.size(), levelCount);
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header)
+        && writeColumn<std::int64_t>(file, orderBooks, [](const OrderBookView& o){ return o.lastUpdateId; })
+        && writeColumn<std::int64_t>(file, orderBooks, [](const OrderBookView& o){ return o.E.count(); })
+        && writeColumn<std::uint64_t>(file, orderBooks, [](const OrderBookView& o){ return o.bids.size(); })
+        && writeColumn<std::uint64_t>(file, orderBooks, [](const OrderBookView& o){ return o.asks.size(); });
+    // each book's bids, then its asks, written straight from the arena
+    for(std::size_t i = 0; ok && i < orderBooks.size(); i++){
+        OrderBookView orderBook = orderBooks[i];
+        for(std::span<const Order> side : {orderBook.bids, orderBook.asks}){
+            qint64 bytes = static_cast<qint64>(side.size_bytes());
+            ok = ok && file.write(reinterpret_cast<const char*>(side.data()), bytes) == bytes;
+        }
+    }
+    return ok && file.commit();
+}
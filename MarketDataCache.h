@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Model.h"
+#include "OrderBookArena.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary cache of a parsed CSV, stored next to it as <source>.rvcache.
+//
+// The file is a CacheHeader followed by one column per field, every element
+// 8 bytes wide so the mapped columns are naturally aligned:
+//   trades:      tradeId[count], price[count], quantity[count], timestamp[count],
+//                isBuyerMaker[count] (one byte each, last so the others stay aligned)
+//   order books: lastUpdateId[count], E[count], bidCount[count], askCount[count],
+//                Order levels[levelCount] (each book's bids, then its asks)
+// A cache is only used when its version, kind and the recorded size and
+// modification time of the source file all still match.
+class MarketDataCache
+{
+public:
+    static constexpr std::uint32_t version = 2;
+
+    enum Kind : std::uint32_t {
+        TRADES,
+        ORDER_BOOKS
+    };
+
+    struct CacheHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t kind;
+        std::int64_t sourceSize;
+        std::int64_t sourceModified;
+        std::uint64_t count;
+        std::uint64_t levelCount;
+    };
+
+    static std::string cachePath(const std::string &sourceFile);
+
+    static bool read(const std::string &sourceFile, TradeColumns &trades);
+    static bool read(const std::string &sourceFile, std::vector<OrderBook> &orderBooks);
+    static bool write(const std::string &sourceFile, const TradeColumns &trades);
+    static bool write(const std::string &sourceFile, const std::vector<OrderBook> &orderBooks);
+    // The same order-book cache, for books kept in an OrderBookArena.
+    static bool read(const std::string &sourceFile, OrderBookArena &orderBooks);
+    static bool write(const std::string &sourceFile, const OrderBookArena &orderBooks);
+};
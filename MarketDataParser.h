@@ -0,0 +1,194 @@
+#pragma once
+
+#include "Model.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MARKET_DATA_PARSER_SSE2
+#endif
+
+// Allocation-free parsers for the Binance CSV exports. They work directly on
+// the raw bytes (usually a MappedFile) and never build intermediate strings.
+class MarketDataParser
+{
+public:
+    static const char *skipPast(const char *p, const char *end, char c){
+        const void *found = std::memchr(p, c, end - p);
+        return found ? static_cast<const char*>(found) + 1 : end;
+    }
+
+    static const char *skipLine(const char *p, const char *end){
+        return skipPast(p, end, '\n');
+    }
+
+    template<typename T>
+    static const char *parseNumber(const char *p, const char *end, T &value){
+        return std::from_chars(p, end, value).ptr;
+    }
+
+    // Rows that do not start with a digit are headers or blank lines.
+    static bool isDataRow(const char *p, const char *end){
+        return p < end && *p >= '0' && *p <= '9';
+    }
+
+    // Splits data into at most maxChunks pieces of at least minChunkSize bytes,
+    // each ending on a newline so that no row straddles two chunks.
+    static std::vector<std::string_view> splitLines(std::string_view data, std::size_t maxChunks, std::size_t minChunkSize = 1 << 20){
+        std::vector<std::string_view> chunks;
+        std::size_t chunkSize = std::max(minChunkSize, data.size() / std::max<std::size_t>(maxChunks, 1) + 1);
+        const char *p = data.data();
+        const char *end = p + data.size();
+        while(p < end){
+            const char *chunkEnd = end - p > static_cast<std::ptrdiff_t>(chunkSize) ? skipLine(p + chunkSize, end) : end;
+            chunks.emplace_back(p, chunkEnd - p);
+            p = chunkEnd;
+        }
+        return chunks;
+    }
+
+    // agg_trade_id,price,quantity,first_trade_id,last_trade_id,transact_time,is_buyer_maker[,is_best_match]
+    static const char *parseTrade(const char *p, const char *end, Trade &trade){
+        p = skipPast(parseNumber(p, end, trade.tradeId), end, ',');
+        p = skipPast(parseNumber(p, end, trade.price), end, ',');
+        p = skipPast(parseNumber(p, end, trade.quantity), end, ',');
+        p = skipPast(p, end, ',');
+        p = skipPast(p, end, ',');
+        unsigned long long timestamp{0};
+        p = parseNumber(p, end, timestamp);
+        trade.timestamp = std::chrono::duration_cast<TimePoint>(std::chrono::microseconds(timestamp));
+        // is_buyer_maker, when the row has it
+        trade.isBuyerMaker = end - p > 1 && *p == ',' && (p[1] == 't' || p[1] == 'T');
+        return skipLine(p, end);
+    }
+
+    // Depth levels come as [[p,q],...] with the numbers either bare or quoted.
+    // Starting at the opening '[', returns the position of the ']' that closes
+    // the array and counts the '[' before it (one per level plus the outer one).
+    static const char *scanLevels(const char *p, const char *end, std::size_t &brackets){
+        brackets = 1;
+        const char *q = p + 1;
+        while(q < end && *q == ' ')
+            q++;
+        if(q >= end || *q == ']')
+            return q;
+        brackets = 0;
+#if defined(MARKET_DATA_PARSER_SSE2)
+        const __m128i open = _mm_set1_epi8('[');
+        const __m128i close = _mm_set1_epi8(']');
+        unsigned carry = 0;
+        for(; end - p >= 16; p += 16){
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            unsigned opens = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, open)));
+            unsigned closes = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, close)));
+            // bit i set when bytes i-1 and i are both ']'
+            unsigned pairs = closes & ((closes << 1) | carry);
+            if(pairs != 0){
+                int last = std::countr_zero(pairs);
+                brackets += std::popcount(opens & ((2u << last) - 1));
+                return p + last;
+            }
+            brackets += std::popcount(opens);
+            carry = closes >> 15;
+        }
+        if(carry != 0 && p < end && *p == ']')
+            return p;
+#endif
+        for(; p < end; p++){
+            if(*p == '[')
+                brackets++;
+            else if(*p == ']' && p + 1 < end && p[1] == ']')
+                return p + 1;
+        }
+        return end;
+    }
+
+    static const char *skipQuotes(const char *p, const char *end){
+        while(p < end && (*p == '"' || *p == ' '))
+            p++;
+        return p;
+    }
+
+    // Appends orders in file order and returns the position after the closing ']'.
+    static const char *appendLevels(const char *p, const char *end, std::vector<Order> &orders){
+        p = static_cast<const char*>(std::memchr(p, '[', end - p));
+        if(p == nullptr)
+            return end;
+        std::size_t brackets;
+        const char *close = scanLevels(p, end, brackets);
+        std::size_t first = orders.size();
+        orders.resize(first + brackets - 1);
+        p++;
+        for(std::size_t i = first; i < orders.size(); i++){
+            p = skipPast(p, close, '[');
+            p = parseNumber(skipQuotes(p, close), close, orders[i].price);
+            p = skipPast(p, close, ',');
+            p = parseNumber(skipQuotes(p, close), close, orders[i].quantity);
+        }
+        return close < end ? close + 1 : end;
+    }
+
+    // Fills orders in file order and returns the position after the closing ']'.
+    static const char *parseLevels(const char *p, const char *end, std::vector<Order> &orders){
+        orders.clear();
+        return appendLevels(p, end, orders);
+    }
+
+    // lastUpdateId,E, and returns the position of the asks.
+    static const char *parseOrderBookHead(const char *p, const char *end, long long &lastUpdateId, TimePoint &E){
+        p = skipPast(parseNumber(p, end, lastUpdateId), end, ',');
+        long long e{0};
+        p = parseNumber(p, end, e);
+        E = TimePoint(e);
+        return p;
+    }
+
+    // lastUpdateId,E,"asks","bids"
+    static const char *parseOrderBook(const char *p, const char *end, OrderBook &orderBook){
+        p = parseOrderBookHead(p, end, orderBook.lastUpdateId, orderBook.E);
+        p = parseLevels(p, end, orderBook.asks);
+        p = parseLevels(p, end, orderBook.bids);
+        return skipLine(p, end);
+    }
+
+    // Stores asks highest first and bids lowest first, so the best level of
+    // each side is back(). Binance sends asks ascending and bids descending,
+    // so a reverse is usually enough.
+    static void sortLevels(std::span<Order> asks, std::span<Order> bids){
+        auto descending = [](const Order& a, const Order& b) -> bool{ return a.price > b.price; };
+        auto ascending = [](const Order& a, const Order& b) -> bool{ return a.price < b.price; };
+        if(std::is_sorted(asks.rbegin(), asks.rend(), descending))
+            std::reverse(asks.begin(), asks.end());
+        else
+            std::sort(asks.begin(), asks.end(), descending);
+        if(std::is_sorted(bids.rbegin(), bids.rend(), ascending))
+            std::reverse(bids.begin(), bids.end());
+        else
+            std::sort(bids.begin(), bids.end(), ascending);
+    }
+
+    static void sortLevels(OrderBook &orderBook){
+        sortLevels(orderBook.asks, orderBook.bids);
+    }
+
+    static void parseTrades(std::string_view data, TradeColumns &trades){
+        const char *p = data.data();
+        const char *end = p + data.size();
+        trades.reserve(trades.size() + std::count(p, end, '\n') + 1);
+        while(p < end){
+            if(!isDataRow(p, end)){
+                p = skipLine(p, end);
+                continue;
+            }
+            Trade trade;
+            p = parseTrade(p, end, trade);
+            trades.push_back(trade);
+        }
+    }
+};
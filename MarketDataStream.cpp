@@ -0,0 +1,88 @@
+#include "MarketDataStream.h"
+#include "MappedFile.h"
+#include "CompressedFile.h"
+#include "MarketDataParser.h"
+#include <algorithm>
+#include <utility>
+
+// Hands the contents of file to parseBlock: in one piece when it is mapped, or
+// block by block while it is decompressed. parseBlock returns false to stop.
+// Returns false when a compressed file turned out to be corrupt or truncated,
+// in which case the block holding the damage is not handed out.
+template<typename ParseBlock>
+static bool forEachBlock(const std::string &file, ParseBlock parseBlock){
+    if(CompressedFile::format(file) == CompressedFile::NONE){
+        MappedFile data(file);
+        parseBlock(data.view());
+        return true;
+    }
+    CompressedFile compressed(file);
+    std::string block;
+    while(compressed.next(block) && !compressed.hasFailed() && parseBlock(std::string_view(block)))
+        ;
+    return !compressed.hasFailed();
+}
+
+MarketDataStream::MarketDataStream(const std::string &marketFile, const std::string &orderBookFile, std::size_t windowSize) :
+tradeQueue{queueCapacity},
+orderBookQueue{queueCapacity},
+tradeReader{tradeQueue},
+orderBookReader{orderBookQueue},
+window{std::max<std::size_t>(windowSize, 1)},
+failed{false}
+{
+    tradeProducer = std::jthread([this, marketFile](){
+        std::vector<Trade> batch;
+        bool read = forEachBlock(marketFile, [this, &batch](std::string_view data){
+            const char *p = data.data();
+            const char *end = p + data.size();
+            while(p < end){
+                if(!MarketDataParser::isDataRow(p, end)){
+                    p = MarketDataParser::skipLine(p, end);
+                    continue;
+                }
+                p = MarketDataParser::parseTrade(p, end, batch.emplace_back());
+                if(batch.size() == tradeBatchSize && !tradeQueue.push(std::exchange(batch, {})))
+                    return false;
+            }
+            return true;
+        });
+        if(!read)
+            failed = true;
+        if(!batch.empty())
+            tradeQueue.push(std::move(batch));
+        tradeQueue.close();
+    });
+
+    orderBookProducer = std::jthread([this, orderBookFile](){
+        std::vector<OrderBook> batch;
+        bool read = forEachBlock(orderBookFile, [this, &batch](std::string_view data){
+            const char *p = data.data();
+            const char *end = p + data.size();
+            while(p < end){
+                if(!MarketDataParser::isDataRow(p, end)){
+                    p = MarketDataParser::skipLine(p, end);
+                    continue;
+                }
+                OrderBook &orderBook = batch.emplace_back();
+                p = MarketDataParser::parseOrderBook(p, end, orderBook);
+                MarketDataParser::sortLevels(orderBook);
+                if(batch.size() == orderBookBatchSize && !orderBookQueue.push(std::exchange(batch, {})))
+                    return false;
+            }
+            return true;
+        });
+        if(!read)
+            failed = true;
+        if(!batch.empty())
+            orderBookQueue.push(std::move(batch));
+        orderBookQueue.close();
+    });
+}
+
+MarketDataStream::~MarketDataStream()
+{
+    // Unblocks producers that are still waiting for room before joining them.
+    tradeQueue.close();
+    orderBookQueue.close();
+}
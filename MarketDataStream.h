@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Model.h"
+#include "BoundedQueue.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Consumer-side cursor over a queue of batches, so the lock is taken once
+// per batch rather than once per row.
+template<typename T>
+class BatchReader
+{
+    BoundedQueue<std::vector<T>> &queue;
+    std::vector<T> batch;
+    std::size_t next;
+
+public:
+    explicit BatchReader(BoundedQueue<std::vector<T>> &queue) :
+    queue{queue},
+    next{0}
+    {
+    }
+
+    // nullptr once the producer is done and everything has been read.
+    T *peek(){
+        while(next == batch.size()){
+            std::optional<std::vector<T>> nextBatch = queue.pop();
+            if(!nextBatch)
+                return nullptr;
+            batch = std::move(*nextBatch);
+            next = 0;
+        }
+        return &batch[next];
+    }
+
+    void pop(){ next++; }
+};
+
+// Parses a trades file and an order-book file on two producer threads while
+// the simulation consumes them. At most queueCapacity batches of each are
+// buffered, so memory does not grow with the size of the files.
+class MarketDataStream
+{
+public:
+    static constexpr std::size_t tradeBatchSize = 4096;
+    static constexpr std::size_t orderBookBatchSize = 16;
+    static constexpr std::size_t queueCapacity = 8;
+
+private:
+    BoundedQueue<std::vector<Trade>> tradeQueue;
+    BoundedQueue<std::vector<OrderBook>> orderBookQueue;
+    BatchReader<Trade> tradeReader;
+    BatchReader<OrderBook> orderBookReader;
+    std::size_t window;
+    std::atomic<bool> failed;
+    std::jthread tradeProducer;
+    std::jthread orderBookProducer;
+
+public:
+    MarketDataStream(const std::string &marketFile, const std::string &orderBookFile, std::size_t windowSize);
+    ~MarketDataStream();
+
+    // Number of trades kept visible to the model behind the newest one.
+    std::size_t windowSize() const { return window; }
+
+    // True when a compressed file was corrupt or truncated. The stream then
+    // ends with the last block decompressed before the damage.
+    bool hasFailed() const { return failed; }
+
+    const Trade *peekTrade(){ return tradeReader.peek(); }
+    void popTrade(){ tradeReader.pop(); }
+    OrderBook *peekOrderBook(){ return orderBookReader.peek(); }
+    void popOrderBook(){ orderBookReader.pop(); }
+};
@@ -1,10 +1,19 @@
 #pragma once
 
 #include <chrono>
+#include <compare>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
 #include <vector>
 #include <list>
 #include <span>
 #include <variant>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <QtCore/qglobal.h>
 
 #if defined(MODEL_LIBRARY)
@@ -43,20 +52,246 @@ typedef struct OrderBook
     bool operator!=(const OrderBook&) const = default;
 } OrderBook;
 
+// Non-owning view of an order-book snapshot, used when the levels of all
+// snapshots are stored contiguously.
+typedef struct OrderBookView
+{
+    long long lastUpdateId;
+    TimePoint E; // Event time
+    std::span<const Order> bids;
+    std::span<const Order> asks;
+} OrderBookView;
+
 typedef struct Trade{
     long long tradeId;
     double price;
     double quantity;
     TimePoint timestamp;
+    bool isBuyerMaker = false; // the buy was resting, so the trade hit the bids
     bool operator==(const Trade&) const = default;
     bool operator!=(const Trade&) const = default;
 } Trade;
 
+struct TradeColumns;
+
+// Random-access iterator over the trades of a TradeColumns, each read back as
+// a Trade value.
+class TradeIterator
+{
+    const TradeColumns *columns = nullptr;
+    std::size_t i = 0;
+
+public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Trade;
+    using difference_type = std::ptrdiff_t;
+    using reference = Trade;
+
+    TradeIterator() = default;
+    TradeIterator(const TradeColumns *columns, std::size_t i) : columns{columns}, i{i} {}
+
+    Trade operator*() const;
+    Trade operator[](difference_type n) const { return *(*this + n); }
+
+    TradeIterator &operator++(){ i++; return *this; }
+    TradeIterator operator++(int){ TradeIterator it = *this; i++; return it; }
+    TradeIterator &operator--(){ i--; return *this; }
+    TradeIterator operator--(int){ TradeIterator it = *this; i--; return it; }
+    TradeIterator &operator+=(difference_type n){ i += n; return *this; }
+    TradeIterator &operator-=(difference_type n){ i -= n; return *this; }
+    friend TradeIterator operator+(TradeIterator it, difference_type n){ return it += n; }
+    friend TradeIterator operator+(difference_type n, TradeIterator it){ return it += n; }
+    friend TradeIterator operator-(TradeIterator it, difference_type n){ return it -= n; }
+    friend difference_type operator-(const TradeIterator &a, const TradeIterator &b){
+        return static_cast<difference_type>(a.i) - static_cast<difference_type>(b.i);
+    }
+
+    bool operator==(const TradeIterator &other) const { return i == other.i; }
+    auto operator<=>(const TradeIterator &other) const { return i <=> other.i; }
+};
+
+// Trades kept one contiguous array per field, so a pass over a single field
+// reads only that field. It is the simulator's only copy of the trade
+// history; a Trade is put together from the four columns when asked for.
+struct TradeColumns
+{
+    std::vector<long long> tradeIds;
+    std::vector<double> prices;
+    std::vector<double> quantities;
+    std::vector<TimePoint> timestamps;
+    std::vector<std::uint8_t> buyerMakers; // isBuyerMaker, one byte each
+
+    TradeColumns() = default;
+    TradeColumns(std::initializer_list<Trade> trades){
+        assign(trades);
+    }
+
+    std::size_t size() const { return prices.size(); }
+    bool empty() const { return prices.empty(); }
+
+    Trade operator[](std::size_t i) const { return Trade{tradeIds[i], prices[i], quantities[i], timestamps[i], buyerMakers[i] != 0}; }
+    Trade front() const { return (*this)[0]; }
+    Trade back() const { return (*this)[size() - 1]; }
+    TradeIterator begin() const { return TradeIterator(this, 0); }
+    TradeIterator end() const { return TradeIterator(this, size()); }
+
+    void reserve(std::size_t n){
+        tradeIds.reserve(n);
+        prices.reserve(n);
+        quantities.reserve(n);
+        timestamps.reserve(n);
+        buyerMakers.reserve(n);
+    }
+
+    void push_back(const Trade &trade){
+        tradeIds.push_back(trade.tradeId);
+        prices.push_back(trade.price);
+        quantities.push_back(trade.quantity);
+        timestamps.push_back(trade.timestamp);
+        buyerMakers.push_back(trade.isBuyerMaker);
+    }
+
+    void assign(std::span<const Trade> trades){
+        clear();
+        reserve(trades.size());
+        for(const auto& trade : trades)
+            push_back(trade);
+    }
+
+    void append(const TradeColumns &other){
+        tradeIds.insert(tradeIds.end(), other.tradeIds.begin(), other.tradeIds.end());
+        prices.insert(prices.end(), other.prices.begin(), other.prices.end());
+        quantities.insert(quantities.end(), other.quantities.begin(), other.quantities.end());
+        timestamps.insert(timestamps.end(), other.timestamps.begin(), other.timestamps.end());
+        buyerMakers.insert(buyerMakers.end(), other.buyerMakers.begin(), other.buyerMakers.end());
+    }
+
+    // Orders the trades from first on by timestamp, keeping the order of
+    // equal ones.
+    void sortByTime(std::size_t first){
+        if(std::is_sorted(timestamps.begin() + first, timestamps.end()))
+            return;
+        std::vector<std::size_t> order(size() - first);
+        for(std::size_t i = 0; i < order.size(); i++)
+            order[i] = first + i;
+        std::stable_sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b){ return timestamps[a] < timestamps[b]; });
+        auto permute = [&](auto &column){
+            std::vector<typename std::remove_reference_t<decltype(column)>::value_type> sorted;
+            sorted.reserve(order.size());
+            for(std::size_t i : order)
+                sorted.push_back(column[i]);
+            std::copy(sorted.begin(), sorted.end(), column.begin() + first);
+        };
+        permute(tradeIds);
+        permute(prices);
+        permute(quantities);
+        permute(timestamps);
+        permute(buyerMakers);
+    }
+
+    // Drops the first n trades.
+    void eraseFront(std::size_t n){
+        tradeIds.erase(tradeIds.begin(), tradeIds.begin() + n);
+        prices.erase(prices.begin(), prices.begin() + n);
+        quantities.erase(quantities.begin(), quantities.begin() + n);
+        timestamps.erase(timestamps.begin(), timestamps.begin() + n);
+        buyerMakers.erase(buyerMakers.begin(), buyerMakers.begin() + n);
+    }
+
+    void clear(){
+        tradeIds.clear();
+        prices.clear();
+        quantities.clear();
+        timestamps.clear();
+        buyerMakers.clear();
+    }
+
+    bool operator==(const TradeColumns&) const = default;
+    bool operator!=(const TradeColumns&) const = default;
+};
+
+inline Trade TradeIterator::operator*() const { return (*columns)[i]; }
+
+// Non-owning view of consecutive trades of a TradeColumns, used like a
+// std::span<const Trade> whose elements are read back as values, with a span
+// of the same trades per field.
+class TradeView
+{
+    const TradeColumns *columns = nullptr;
+    std::size_t offset = 0;
+    std::size_t count = 0;
+
+    template<typename T>
+    std::span<const T> column(const std::vector<T> &all) const {
+        return std::span(all).subspan(offset, count);
+    }
+
+public:
+    TradeView() = default;
+    TradeView(const TradeColumns &columns) : columns{&columns}, count{columns.size()} {}
+    TradeView(const TradeColumns &columns, std::size_t offset, std::size_t count) : columns{&columns}, offset{offset}, count{count} {}
+    TradeView(const TradeColumns &&) = delete;
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    Trade operator[](std::size_t i) const { return (*columns)[offset + i]; }
+    Trade front() const { return (*this)[0]; }
+    Trade back() const { return (*this)[count - 1]; }
+    TradeIterator begin() const { return TradeIterator(columns, offset); }
+    TradeIterator end() const { return TradeIterator(columns, offset + count); }
+
+    TradeView first(std::size_t n) const { return subspan(0, n); }
+    TradeView last(std::size_t n) const { return subspan(count - n, n); }
+    TradeView subspan(std::size_t from, std::size_t n = std::dynamic_extent) const {
+        TradeView view = *this;
+        view.offset += from;
+        view.count = n == std::dynamic_extent ? count - from : n;
+        return view;
+    }
+
+    std::span<const long long> tradeIds() const { return columns ? column(columns->tradeIds) : std::span<const long long>(); }
+    std::span<const double> prices() const { return columns ? column(columns->prices) : std::span<const double>(); }
+    std::span<const double> quantities() const { return columns ? column(columns->quantities) : std::span<const double>(); }
+    std::span<const TimePoint> timestamps() const { return columns ? column(columns->timestamps) : std::span<const TimePoint>(); }
+    std::span<const std::uint8_t> buyerMakers() const { return columns ? column(columns->buyerMakers) : std::span<const std::uint8_t>(); }
+
+    // The same trades of the same columns.
+    bool operator==(const TradeView&) const = default;
+};
+
 typedef struct MarketHistory
 {
-    std::span<const Trade> trades;
+    TradeView trades;
+    std::size_t newTrades = 0; // trades at the end of trades added since the model was last called
+
+    // Per-field views of trades.
+    std::span<const long long> tradeIds() const { return trades.tradeIds(); }
+    std::span<const double> prices() const { return trades.prices(); }
+    std::span<const double> quantities() const { return trades.quantities(); }
+    std::span<const TimePoint> timestamps() const { return trades.timestamps(); }
+    std::span<const std::uint8_t> buyerMakers() const { return trades.buyerMakers(); }
+
+    TradeView sinceLastCall() const { return trades.last(std::min(newTrades, trades.size())); }
+
+    // Index in trades of the first trade at or after time.
+    std::size_t lowerBound(TimePoint time) const {
+        std::span<const TimePoint> t = timestamps();
+        return std::lower_bound(t.begin(), t.end(), time) - t.begin();
+    }
+
+    // Index in trades of the first trade after time.
+    std::size_t upperBound(TimePoint time) const {
+        std::span<const TimePoint> t = timestamps();
+        return std::upper_bound(t.begin(), t.end(), time) - t.begin();
+    }
+
+    // Trades at or after time.
+    TradeView since(TimePoint time) const { return trades.subspan(lowerBound(time)); }
+
     bool operator==(const MarketHistory& m) const{
-        return this->trades.data() == m.trades.data() && this->trades.size() == m.trades.size();
+        return this->trades == m.trades;
     }
     bool operator!=(const MarketHistory& m) const{
         return !operator==(m);
@@ -68,20 +303,24 @@ struct MarketOrder;
 struct LimitOrder;
 struct StopOrder;
 struct Cancel;
+struct Amend;
 
 class Action
 {
     friend class Simulator;
+    friend class ActionPool;
 
 protected:
     int actionId;
     std::size_t actionIndex;
+    bool pooled; // allocated from an ActionPool rather than with new
 
 public:
 
     Action(int actionIndex) :
+    actionId{0},
     actionIndex(actionIndex),
-    actionId{0}
+    pooled{false}
     {
     }
 
@@ -96,7 +335,9 @@ public:
         else if(std::is_same_v<T, StopOrder>)
             return 2;
         else if(std::is_same_v<T, Cancel>)
-            return 3;         
+            return 3;
+        else if(std::is_same_v<T, Amend>)
+            return 4;
     }
 
     std::size_t index() const { return actionIndex;}
@@ -124,11 +365,15 @@ struct LimitOrder : public Action{
     ActionType actionType;  
     double quantity;
     double price;
+    double queueAhead; // while pending, quantity resting before this order at its price
+    double filled; // while pending, quantity already filled
     LimitOrder(ActionType actionType, double quantity, double price) : 
     Action(Action::typeIndex<LimitOrder>()),
     actionType{actionType},
     quantity{quantity},
-    price{price}
+    price{price},
+    queueAhead{0},
+    filled{0}
     {}
 };
 
@@ -154,13 +399,131 @@ struct Cancel : public Action{
     {}
 };
 
+// Changes the price and quantity of a pending limit or stop order in place.
+// quantity includes what already filled. Lowering only the quantity keeps the
+// order's place in the queue.
+struct Amend : public Action{
+    friend class Simulator;
+    int orderId;
+    double quantity;
+    double price;
+    Amend(int orderId, double quantity, double price) : 
+    Action(Action::typeIndex<Amend>()),
+    orderId{orderId},
+    quantity{quantity},
+    price{price}
+    {}
+};
+
+// An action held by value. Every alternative derives from Action, so
+// std::visit can hand any of them out as a const Action&.
+using ActionValue = std::variant<MarketOrder, LimitOrder, StopOrder, Cancel, Amend>;
+
+// Recycled storage for actions. The simulator owns one and returns each
+// action to it once processed, so in steady state submitting an order does
+// not allocate.
+class ActionPool
+{
+    static constexpr std::size_t slotSize = std::max({sizeof(MarketOrder), sizeof(LimitOrder), sizeof(StopOrder), sizeof(Cancel), sizeof(Amend)});
+    static constexpr std::size_t blockSize = 256;
+
+    struct alignas(std::max_align_t) Slot
+    {
+        unsigned char bytes[slotSize];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    std::vector<Slot*> freeSlots;
+
+public:
+    template<typename T, typename... Args>
+    T *make(Args&&... args){
+        static_assert(std::is_trivially_destructible_v<T> && sizeof(T) <= slotSize);
+        if(freeSlots.empty()){
+            blocks.push_back(std::make_unique<Slot[]>(blockSize));
+            for(std::size_t i = blockSize; i > 0; i--)
+                freeSlots.push_back(&blocks.back()[i - 1]);
+        }
+        T *action = new (freeSlots.back()) T(std::forward<Args>(args)...);
+        freeSlots.pop_back();
+        action->pooled = true;
+        return action;
+    }
+
+    void release(const Action *action){
+        freeSlots.push_back(reinterpret_cast<Slot*>(const_cast<Action*>(action)));
+    }
+};
+
+// When the simulator calls Model::run. The model is called on a timestep if
+// any of the enabled conditions holds; pending orders are still processed on
+// every timestep.
+struct WakeConditions
+{
+    bool everyTimestep = true;
+    bool onOrderBook = false; // a new order-book snapshot since the last call
+    bool onFill = false; // an order filled since the last call
+    TimePoint at = TimePoint::max(); // the timestep time reaches at
+    double priceAtOrAbove = std::numeric_limits<double>::infinity(); // last trade price
+    double priceAtOrBelow = -std::numeric_limits<double>::infinity(); // last trade price
+};
+
 class MODEL_API Model{
 
+    friend class Simulator;
+
+    WakeConditions wake;
+    ActionPool *actionPool = nullptr;
+    std::vector<ActionValue> submitted; // emptied by the simulator after each run call
+
+protected:
+
+    // Usually called from run to choose the next wake-up.
+    void setWakeConditions(const WakeConditions &conditions){ wake = conditions; }
+
+    // Hands an action to the simulator by value from inside run. It is
+    // processed after run returns, before any actions run returned.
+    void submit(const ActionValue &action){ submitted.push_back(action); }
+
+    // Creates an action to return from run. Inside a simulation it comes from
+    // the simulator's pool instead of the heap.
+    template<typename T, typename... Args>
+    T *make(Args&&... args){
+        return actionPool ? actionPool->make<T>(std::forward<Args>(args)...) : new T(std::forward<Args>(args)...);
+    }
+
 public:
     
     Model() = default;
     virtual ~Model() = default;
 
+    const WakeConditions &wakeConditions() const { return wake; }
+
     virtual std::vector<Action *> run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions, 
                const MarketHistory &market, const OrderBook &orderBook) = 0;
+
+    // Called instead of the OrderBook overload when the simulator keeps order
+    // books in flat storage. Override it to read the levels without a copy.
+    virtual std::vector<Action *> run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions, 
+               const MarketHistory &market, const OrderBookView &orderBook){
+        thread_local OrderBook copy;
+        copy.lastUpdateId = orderBook.lastUpdateId;
+        copy.E = orderBook.E;
+        copy.bids.assign(orderBook.bids.begin(), orderBook.bids.end());
+        copy.asks.assign(orderBook.asks.begin(), orderBook.asks.end());
+        return run(portfolio, pendingActions, market, copy);
+    }
+
+    // The forms the simulator calls. out is a buffer the simulator reuses, so
+    // a model that overrides these and fills out with make'd actions does not
+    // allocate per timestep. By default they forward to the overloads above.
+    virtual void run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions, 
+               const MarketHistory &market, const OrderBook &orderBook, std::vector<Action *> &out){
+        out = run(portfolio, pendingActions, market, orderBook);
+    }
+
+    virtual void run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions, 
+               const MarketHistory &market, const OrderBookView &orderBook, std::vector<Action *> &out){
+        out = run(portfolio, pendingActions, market, orderBook);
+    }
 };
\ No newline at end of file
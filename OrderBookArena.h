@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Model.h"
+#include "MarketDataParser.h"
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Order-book history with the levels of every snapshot in a few large
+// buffers: one per parsed chunk of a file, or a single one when snapshots are
+// appended one by one. A snapshot is only a buffer, an offset and two lengths
+// into it, handed out as an OrderBookView, so no snapshot allocates.
+class OrderBookArena
+{
+    struct Extent
+    {
+        long long lastUpdateId;
+        TimePoint E;
+        std::size_t offset; // asks, then bids
+        std::uint32_t buffer;
+        std::uint32_t asks;
+        std::uint32_t bids;
+    };
+
+    std::vector<Extent> extents;
+    std::vector<std::vector<Order>> buffers;
+
+    std::vector<Order> &lastBuffer(){
+        return buffers.empty() ? buffers.emplace_back() : buffers.back();
+    }
+
+public:
+    // Makes room for that many more snapshots and levels to be appended.
+    void reserve(std::size_t snapshots, std::size_t levelCount){
+        extents.reserve(extents.size() + snapshots);
+        std::vector<Order> &levels = lastBuffer();
+        levels.reserve(levels.size() + levelCount);
+    }
+
+    void append(long long lastUpdateId, TimePoint E, std::span<const Order> bids, std::span<const Order> asks){
+        std::vector<Order> &levels = lastBuffer();
+        extents.push_back(Extent{lastUpdateId, E, levels.size(), static_cast<std::uint32_t>(buffers.size() - 1),
+            static_cast<std::uint32_t>(asks.size()), static_cast<std::uint32_t>(bids.size())});
+        levels.insert(levels.end(), asks.begin(), asks.end());
+        levels.insert(levels.end(), bids.begin(), bids.end());
+    }
+
+    void append(const OrderBook &orderBook){
+        append(orderBook.lastUpdateId, orderBook.E, orderBook.bids, orderBook.asks);
+    }
+
+    // Takes over the snapshots of other, buffers and all, so no level is copied.
+    void append(OrderBookArena &&other){
+        if(extents.empty() && buffers.empty()){
+            *this = std::move(other);
+            return;
+        }
+        auto firstBuffer = static_cast<std::uint32_t>(buffers.size());
+        extents.reserve(extents.size() + other.extents.size());
+        for(Extent extent : other.extents){
+            extent.buffer += firstBuffer;
+            extents.push_back(extent);
+        }
+        buffers.insert(buffers.end(), std::make_move_iterator(other.buffers.begin()), std::make_move_iterator(other.buffers.end()));
+        other = OrderBookArena();
+    }
+
+    // Parses lastUpdateId,E,"asks","bids" rows into a buffer of their own,
+    // sized once up front: every level opens a bracket, so there is never
+    // more of them than '[' in data.
+    void parse(std::string_view data){
+        const char *p = data.data();
+        const char *end = p + data.size();
+        std::vector<Order> &levels = buffers.emplace_back();
+        levels.reserve(std::count(p, end, '['));
+        extents.reserve(extents.size() + std::count(p, end, '\n') + 1);
+        while(p < end){
+            if(!MarketDataParser::isDataRow(p, end)){
+                p = MarketDataParser::skipLine(p, end);
+                continue;
+            }
+            Extent extent{0, TimePoint(0), levels.size(), static_cast<std::uint32_t>(buffers.size() - 1), 0, 0};
+            p = MarketDataParser::parseOrderBookHead(p, end, extent.lastUpdateId, extent.E);
+            p = MarketDataParser::appendLevels(p, end, levels);
+            extent.asks = static_cast<std::uint32_t>(levels.size() - extent.offset);
+            p = MarketDataParser::appendLevels(p, end, levels);
+            extent.bids = static_cast<std::uint32_t>(levels.size() - extent.offset - extent.asks);
+            p = MarketDataParser::skipLine(p, end);
+            std::span<Order> all(levels.data() + extent.offset, extent.asks + extent.bids);
+            MarketDataParser::sortLevels(all.first(extent.asks), all.subspan(extent.asks));
+            extents.push_back(extent);
+        }
+    }
+
+    // Orders the snapshots from first on by E, keeping the order of equal
+    // ones. Only the extents move.
+    void sortByTime(std::size_t first){
+        auto byTime = [](const Extent &a, const Extent &b){ return a.E < b.E; };
+        if(!std::is_sorted(extents.begin() + first, extents.end(), byTime))
+            std::stable_sort(extents.begin() + first, extents.end(), byTime);
+    }
+
+    std::size_t size() const { return extents.size(); }
+    bool empty() const { return extents.empty(); }
+
+    OrderBookView view(std::size_t i) const {
+        const Extent &extent = extents[i];
+        std::span<const Order> all(buffers[extent.buffer].data() + extent.offset, extent.asks + extent.bids);
+        return OrderBookView{extent.lastUpdateId, extent.E, all.subspan(extent.asks), all.first(extent.asks)};
+    }
+
+    OrderBookView operator[](std::size_t i) const { return view(i); }
+
+    OrderBook orderBook(std::size_t i) const {
+        OrderBookView v = view(i);
+        return OrderBook{v.lastUpdateId, v.E, std::vector<Order>(v.bids.begin(), v.bids.end()), std::vector<Order>(v.asks.begin(), v.asks.end())};
+    }
+
+    std::size_t memoryUsage() const {
+        std::size_t bytes = extents.capacity() * sizeof(Extent) + buffers.capacity() * sizeof(std::vector<Order>);
+        for(const auto& levels : buffers)
+            bytes += levels.capacity() * sizeof(Order);
+        return bytes;
+    }
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "Model.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// Resting limit and stop orders, split by kind and side and sorted by price so
+// that the orders a trade price triggers are always at the front of their
+// side. Orders at the same price keep the order they were inserted in. An
+// index by action id finds any order without searching the sides, and a list
+// in id order, kept up to date as orders come and go, hands them all out
+// oldest first. The nodes of the sides and of the index come from a pool that
+// keeps the ones orders leave, so in steady state placing an order does not
+// allocate.
+class PendingOrders
+{
+    std::pmr::unsynchronized_pool_resource nodes; // declared first, so it outlives the containers
+
+    template<typename T, typename Compare>
+    using Side = std::pmr::multimap<double, T, Compare>;
+
+    // Each side is sorted so that the first order is the first one a moving
+    // price reaches.
+    Side<LimitOrder, std::greater<double>> buyLimits{&nodes}; // fill at or below the price
+    Side<LimitOrder, std::less<double>> sellLimits{&nodes}; // fill at or above the price
+    Side<StopOrder, std::less<double>> buyStops{&nodes}; // trigger at or above the price
+    Side<StopOrder, std::greater<double>> sellStops{&nodes}; // trigger at or below the price
+
+    // Where an order is, as an iterator into one of the sides above, in the
+    // order they are declared.
+    using Location = std::variant<decltype(buyLimits)::iterator, decltype(sellLimits)::iterator,
+        decltype(buyStops)::iterator, decltype(sellStops)::iterator>;
+    std::pmr::unordered_map<int, Location> byId{&nodes};
+    // Every resting order in id order. Map nodes keep their address when an
+    // amend moves them, so only inserting and removing an order touch this.
+    std::vector<const Action*> byAge;
+
+    static bool olderThan(const Action *order, int actionId){ return order->getId() < actionId; }
+
+    // Ids only grow, so a new order nearly always goes at the back of byAge.
+    template<std::size_t Index, typename S, typename T>
+    void insertInto(S &side, const T &order){
+        auto it = side.emplace(order.price, order);
+        byId.insert_or_assign(order.getId(), Location(std::in_place_index<Index>, it));
+        if(byAge.empty() || byAge.back()->getId() < order.getId())
+            byAge.push_back(&it->second);
+        else
+            byAge.insert(std::lower_bound(byAge.begin(), byAge.end(), order.getId(), olderThan), &it->second);
+    }
+
+    void forget(int actionId){
+        byId.erase(actionId);
+        auto it = std::lower_bound(byAge.begin(), byAge.end(), actionId, olderThan);
+        if(it != byAge.end() && (*it)->getId() == actionId)
+            byAge.erase(it);
+    }
+
+    // Calls fill with every order of side that price reaches and removes them.
+    template<typename S, typename Fill>
+    std::size_t triggerSide(S &side, double price, Fill &fill){
+        auto end = side.upper_bound(price);
+        std::size_t count = 0;
+        for(auto it = side.begin(); it != end; ++it, ++count){
+            fill(it->second);
+            forget(it->second.getId());
+        }
+        side.erase(side.begin(), end);
+        return count;
+    }
+
+    // Unfilled quantity of the limit orders resting at price on side, which is
+    // queued ahead of any order placed there after them.
+    template<typename S>
+    static double restingAt(const S &side, double price){
+        double quantity = 0;
+        auto [first, last] = side.equal_range(price);
+        for(auto it = first; it != last; ++it)
+            quantity += it->second.quantity - it->second.filled;
+        return quantity;
+    }
+
+    // quantity of the order at it left the queue other than by trading, so
+    // the orders behind it at its price have that much less ahead of them.
+    template<typename S>
+    static void leaveQueue(S &side, typename S::iterator it, double quantity){
+        double price = it->first;
+        for(++it; it != side.end() && it->first == price; ++it)
+            it->second.queueAhead = std::max(0.0, it->second.queueAhead - quantity);
+    }
+
+    // hit is whether the trade took liquidity from this side; only then does
+    // it trade at its own price.
+    template<typename S, typename Fill>
+    std::size_t matchSide(S &side, const Trade &trade, bool hit, Fill &fill){
+        std::size_t count = 0;
+        double left = trade.quantity; // what our orders at the trade price have not taken yet
+        for(auto it = side.begin(), end = side.upper_bound(trade.price); it != end; ){
+            LimitOrder &lo = it->second;
+            double quantity = lo.quantity - lo.filled;
+            if(lo.price == trade.price){
+                // The orders at the price are visited in queue order. What
+                // is ahead of each, our earlier orders included, takes the
+                // trade first, so the trade is shared out only once.
+                double reached = hit ? trade.quantity - lo.queueAhead : 0;
+                if(hit)
+                    lo.queueAhead = std::max(0.0, lo.queueAhead - trade.quantity);
+                quantity = std::min({quantity, reached, left});
+                if(quantity <= 0){
+                    ++it;
+                    continue;
+                }
+                left -= quantity;
+            }
+            lo.filled += quantity;
+            fill(lo, quantity);
+            count++;
+            if(lo.filled < lo.quantity){
+                ++it;
+                continue;
+            }
+            forget(lo.getId());
+            it = side.erase(it);
+        }
+        return count;
+    }
+
+    // Sets the quantity and price of the order at it. A new price, or more
+    // quantity, puts it at the back of the queue at its price.
+    template<std::size_t Index, typename S>
+    void amendIn(S &side, typename S::iterator it, double quantity, double price, double queueAhead){
+        auto &order = it->second;
+        bool requeue = price != order.price || quantity > order.quantity;
+        constexpr bool limit = std::is_same_v<typename S::mapped_type, LimitOrder>;
+        if constexpr(limit)
+            leaveQueue(side, it, requeue ? order.quantity - order.filled : order.quantity - quantity);
+        order.quantity = quantity;
+        if(!requeue)
+            return;
+        auto node = side.extract(it);
+        node.key() = price;
+        node.mapped().price = price;
+        if constexpr(limit)
+            node.mapped().queueAhead = queueAhead + restingAt(side, price);
+        int actionId = node.mapped().getId();
+        byId.insert_or_assign(actionId, Location(std::in_place_index<Index>, side.insert(std::move(node))));
+    }
+
+public:
+    // Our orders already resting at its price are added to the queueAhead of
+    // lo.
+    void insert(const LimitOrder &lo){
+        LimitOrder queued = lo;
+        if(lo.actionType == BUY){
+            queued.queueAhead += restingAt(buyLimits, lo.price);
+            insertInto<0>(buyLimits, queued);
+        }else{
+            queued.queueAhead += restingAt(sellLimits, lo.price);
+            insertInto<1>(sellLimits, queued);
+        }
+    }
+
+    void insert(const StopOrder &so){
+        if(so.actionType == BUY)
+            insertInto<2>(buyStops, so);
+        else
+            insertInto<3>(sellStops, so);
+    }
+
+    // Calls fill(const LimitOrder&) or fill(const StopOrder&) with every order
+    // that a trade at price fills or triggers, then removes them. Only those
+    // orders are visited. Returns how many there were.
+    template<typename Fill>
+    std::size_t trigger(double price, Fill fill){
+        return triggerSide(buyLimits, price, fill) + triggerSide(sellLimits, price, fill)
+            + triggerSide(buyStops, price, fill) + triggerSide(sellStops, price, fill);
+    }
+
+    // Calls fill with every stop order that a trade at price triggers, then
+    // removes them. Limit orders are left to match.
+    template<typename Fill>
+    std::size_t triggerStops(double price, Fill fill){
+        return triggerSide(buyStops, price, fill) + triggerSide(sellStops, price, fill);
+    }
+
+    // Matches one trade against the resting limit orders, calling
+    // fill(const LimitOrder&, double quantity) for each one it fills, after
+    // adding quantity to its filled, and removing those it fills completely.
+    // Orders the trade went through fill outright. At the trade price only
+    // the side it hit trades: a buyer-maker trade hit the bids, any other the
+    // asks. There the trade's quantity first takes what was queued ahead of
+    // each order and the rest may fill orders partially, never more than the
+    // trade's quantity in all.
+    template<typename Fill>
+    std::size_t match(const Trade &trade, Fill fill){
+        return matchSide(buyLimits, trade, trade.isBuyerMaker, fill) + matchSide(sellLimits, trade, !trade.isBuyerMaker, fill);
+    }
+
+    bool hasLimits() const { return !buyLimits.empty() || !sellLimits.empty(); }
+
+    // Removes the order with actionId and returns it, if it is resting.
+    std::optional<ActionValue> erase(int actionId){
+        auto found = byId.find(actionId);
+        if(found == byId.end())
+            return std::nullopt;
+        Location location = found->second;
+        ActionValue order = std::visit([](auto it) -> ActionValue { return it->second; }, location);
+        forget(actionId);
+        switch(location.index())
+        {
+        case 0:
+            leaveQueue(buyLimits, std::get<0>(location), std::get<0>(location)->second.quantity - std::get<0>(location)->second.filled);
+            buyLimits.erase(std::get<0>(location));
+            break;
+        case 1:
+            leaveQueue(sellLimits, std::get<1>(location), std::get<1>(location)->second.quantity - std::get<1>(location)->second.filled);
+            sellLimits.erase(std::get<1>(location));
+            break;
+        case 2: buyStops.erase(std::get<2>(location)); break;
+        default: sellStops.erase(std::get<3>(location)); break;
+        }
+        return order;
+    }
+
+    // The resting order with actionId, or nullptr.
+    const Action *find(int actionId) const {
+        auto found = byId.find(actionId);
+        if(found == byId.end())
+            return nullptr;
+        return std::visit([](auto it) -> const Action* { return &it->second; }, found->second);
+    }
+
+    // Changes the quantity and price of the resting order with actionId. A
+    // limit order that loses its place is given queueAhead.
+    bool amend(int actionId, double quantity, double price, double queueAhead = 0){
+        auto found = byId.find(actionId);
+        if(found == byId.end())
+            return false;
+        Location location = found->second;
+        switch(location.index())
+        {
+        case 0: amendIn<0>(buyLimits, std::get<0>(location), quantity, price, queueAhead); break;
+        case 1: amendIn<1>(sellLimits, std::get<1>(location), quantity, price, queueAhead); break;
+        case 2: amendIn<2>(buyStops, std::get<2>(location), quantity, price, queueAhead); break;
+        default: amendIn<3>(sellStops, std::get<3>(location), quantity, price, queueAhead); break;
+        }
+        return true;
+    }
+
+    // Every resting order, oldest first. The pointers stay valid until that
+    // order is removed.
+    const std::vector<const Action*> &resting() const { return byAge; }
+
+    // Appends every resting order to out, oldest first.
+    void collect(std::vector<const Action*> &out) const {
+        out.insert(out.end(), byAge.begin(), byAge.end());
+    }
+
+    std::size_t size() const {
+        return buyLimits.size() + sellLimits.size() + buyStops.size() + sellStops.size();
+    }
+
+    bool empty() const { return size() == 0; }
+
+    void clear(){
+        buyLimits.clear();
+        sellLimits.clear();
+        buyStops.clear();
+        sellStops.clear();
+        byId.clear();
+        byAge.clear();
+    }
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <QtCore/qglobal.h>
+
+#if defined(REVIVAL_LIBRARY)
+# define REVIVAL_API Q_DECL_EXPORT
+#else
+# define REVIVAL_API Q_DECL_IMPORT
+#endif
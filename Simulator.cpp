@@ -1,31 +1,56 @@
 #include "Simulator.h"
+#include "MappedFile.h"
+#include "MarketDataCache.h"
+#include "MarketDataParser.h"
+#include "MarketDataStream.h"
+#include "CompressedFile.h"
+#include "DeltaOrderBookStore.h"
+#include "OrderBookArena.h"
 #include <fstream>
 #include <QCoreApplication>
-#include <QJsonDocument>
-#include <QJsonArray>
 #include <algorithm>
 #include <cmath>
 #include <QThreadPool>
+#include <QSaveFile>
+#include <iterator>
+#include <filesystem>
+#include <deque>
+#include <semaphore>
+#include <optional>
+#include <stdexcept>
 #include "spdlog/sinks/basic_file_sink.h"
 #include "spdlog/async.h"
 
-Simulator::SimulatorLogger::SimulatorLogger()
+Simulator::SimulatorLogger::SimulatorLogger(bool traceTimesteps, std::string dirPath)
 {
-    std::string dirPath{QCoreApplication::applicationDirPath().toStdString()+"/Logs/"};
+    if(dirPath.empty())
+        dirPath = QCoreApplication::applicationDirPath().toStdString()+"/Logs/";
     std::string currentTime{QDateTime::currentDateTime().toString("dd-MM-yyyy-HH'h'mm'm'").toStdString()};
-    timestepLogger = spdlog::basic_logger_mt<spdlog::async_factory>("timestepLogger", dirPath+"timesteps-"+currentTime+".csv");
+    if(traceTimesteps){
+        timestepLogger = spdlog::basic_logger_mt<spdlog::async_factory>("timestepLogger", dirPath+"timesteps-"+currentTime+".csv");
+        timestepLogger->set_pattern("%v");
+        timestepLogger->info("timepoint, orderBookIndex, marketHistoryIndex");
+    }
     actionsLogger = spdlog::basic_logger_mt<spdlog::async_factory>("actionsLogger", dirPath+"actions-"+currentTime+".csv");
     portfolioLogger = spdlog::basic_logger_mt<spdlog::async_factory>("portfolioLogger", dirPath+"portfolio-"+currentTime+".csv");
 
-    timestepLogger->set_pattern("%v");
     actionsLogger->set_pattern("%v");
     portfolioLogger->set_pattern("%v");
 
-    timestepLogger->info("timepoint, orderBookIndex, marketHistoryIndex");
     actionsLogger->info("timepoint, state, id, type, side, quantity, price, orderId, processedQuantity, processedPrice, total");
     portfolioLogger->info("timestamp, timepoint, authMoney, pendingMoney, authQuantity, pendingQuantity, value");
 };
 
+// Unregisters the loggers so that the next SimulatorLogger can take their names.
+Simulator::SimulatorLogger::~SimulatorLogger()
+{
+    flush();
+    if(timestepLogger)
+        spdlog::drop("timestepLogger");
+    spdlog::drop("actionsLogger");
+    spdlog::drop("portfolioLogger");
+}
+
 const char* Simulator::SimulatorLogger::actionStateString(ActionState s){
     switch(s){
     case ActionState::Awaiting: return "a";
@@ -33,6 +58,8 @@ const char* Simulator::SimulatorLogger::actionStateString(ActionState s){
     case ActionState::Pending: return "p";
     case ActionState::Cancelled: return "c";
     case ActionState::Error: return "e";
+    case ActionState::PartiallyFilled: return "pf";
+    case ActionState::Amended: return "m";
     default: return "";
     }
 };
@@ -76,13 +103,24 @@ void Simulator::SimulatorLogger::logAction(TimePoint t, ActionState s, const Can
         "C", "", "", "", c.orderId, "", "", "");
 };
 
+void Simulator::SimulatorLogger::logAction(TimePoint t, ActionState s, const Amend &a){
+    actionsLogger->info("{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}", t.count(), actionStateString(s), a.actionId, 
+        "A", "", a.quantity, a.price, a.orderId, "", "", "");
+};
+
+void Simulator::SimulatorLogger::logBatch(TimePoint t, std::size_t actions){
+    actionsLogger->info("{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}", t.count(), actionStateString(Awaiting), "", 
+        "B", "", actions, "", "", "", "", "");
+};
+
 void Simulator::SimulatorLogger::logPortfolio(TimePoint t, const Portfolio &p, double value){
     portfolioLogger->info("{}, {}, {}, {}, {}, {}, {}", QDateTime::currentMSecsSinceEpoch(), t.count(), 
         p.authMoney, p.pendingMoney, p.authQuantity, p.pendingQuantity, value);
 };
 
 void Simulator::SimulatorLogger::flush(){
-    timestepLogger->flush();
+    if(timestepLogger)
+        timestepLogger->flush();
     actionsLogger->flush();
     portfolioLogger->flush();
 }
@@ -90,26 +128,302 @@ void Simulator::SimulatorLogger::flush(){
 const OrderBook Simulator::initialOrderBook{0, TimePoint::zero(), std::vector<Order>(), std::vector<Order>()};
 int Simulator::nextActionId{1};
 
-Simulator::Simulator()
+Simulator::Simulator() :
+logger{nullptr},
+tradePrice{0},
+model{nullptr},
+tsInterval{1000},
+traceLevel{NO_TRACE},
+orderBookStorage{FULL},
+fillModel{LAST_TRADE},
+limitFillModel{TOUCH},
+queuedTradeEnd{0},
+marketHistoryLookback{std::numeric_limits<std::size_t>::max()},
+historyBase{0},
+lastRunTradeEnd{0},
+hasLatency{false},
+latencySeed{0},
+inFlightSequence{0}
 {
 }
 
+// The model may outlive the simulator, so it goes back to making its actions
+// on the heap.
 Simulator::~Simulator()
 {
+    if(model)
+        model->actionPool = nullptr;
+    delete logger;
 }
 
 
 void Simulator::fromJSONString(std::string &str, std::vector<Order> &v){
-    QJsonDocument json = QJsonDocument::fromJson(QByteArray::fromStdString(str));
-    QJsonArray array = json.array();
-    v.resize(array.size());
-    for(int i = 0; i < array.size(); i++){
-        QJsonArray order = array[i].toArray();
-        v[i].price = order[0].toDouble();
-        v[i].quantity = order[1].toDouble();
+    MarketDataParser::parseLevels(str.data(), str.data() + str.size(), v);
+}
+
+void Simulator::parseOrderBooks(std::string_view orderBookData, std::vector<OrderBook> &books){
+    const char *p = orderBookData.data();
+    const char *end = p + orderBookData.size();
+    books.reserve(books.size() + std::count(p, end, '\n') + 1);
+    while(p < end){
+        if(!MarketDataParser::isDataRow(p, end)){
+            p = MarketDataParser::skipLine(p, end);
+            continue;
+        }
+        OrderBook &orderBook = books.emplace_back();
+        p = MarketDataParser::parseOrderBook(p, end, orderBook);
+        MarketDataParser::sortLevels(orderBook);
+    }
+}
+
+// ChunkedParse, FileLoad and mergeByTime load order books into a vector, or,
+// when they are kept FLAT, into an OrderBookArena, and trades into
+// TradeColumns. These are the places where the three differ.
+
+// Moves the rows of every run to the end of out, in order.
+template<typename T>
+static void appendRows(std::vector<T> &out, const std::vector<std::vector<T>*> &runs){
+    auto run = runs.begin();
+    if(out.empty() && run != runs.end())
+        out = std::move(**run++);
+    std::size_t size = out.size();
+    for(auto next = run; next != runs.end(); ++next)
+        size += (*next)->size();
+    out.reserve(size);
+    for(; run != runs.end(); ++run){
+        out.insert(out.end(), std::make_move_iterator((*run)->begin()), std::make_move_iterator((*run)->end()));
+        **run = std::vector<T>();
+    }
+}
+
+static void appendRows(TradeColumns &out, const std::vector<TradeColumns*> &runs){
+    auto run = runs.begin();
+    if(out.empty() && run != runs.end())
+        out = std::move(**run++);
+    std::size_t size = out.size();
+    for(auto next = run; next != runs.end(); ++next)
+        size += (*next)->size();
+    out.reserve(size);
+    for(; run != runs.end(); ++run){
+        out.append(**run);
+        **run = TradeColumns();
     }
 }
 
+// The arena takes over the level buffers of every run, so nothing is copied.
+static void appendRows(OrderBookArena &out, const std::vector<OrderBookArena*> &runs){
+    for(auto *run : runs)
+        out.append(std::move(*run));
+}
+
+template<typename T, typename Time>
+static TimePoint firstTime(const std::vector<T> &rows, Time time){
+    return time(rows.front());
+}
+
+template<typename Time>
+static TimePoint firstTime(const TradeColumns &rows, Time){
+    return rows.timestamps.front();
+}
+
+template<typename Time>
+static TimePoint firstTime(const OrderBookArena &rows, Time time){
+    return time(rows.view(0));
+}
+
+template<typename T, typename Time>
+static void sortByTime(std::vector<T> &rows, std::size_t first, Time time){
+    auto byTime = [&time](const T &a, const T &b){ return time(a) < time(b); };
+    if(!std::is_sorted(rows.begin() + first, rows.end(), byTime))
+        std::stable_sort(rows.begin() + first, rows.end(), byTime);
+}
+
+template<typename Time>
+static void sortByTime(TradeColumns &rows, std::size_t first, Time){
+    rows.sortByTime(first);
+}
+
+template<typename Time>
+static void sortByTime(OrderBookArena &rows, std::size_t first, Time){
+    rows.sortByTime(first);
+}
+
+// Parses input on a thread pool in newline-aligned chunks, each into rows of
+// its own, and appends the pieces to the output in file order.
+template<typename Rows>
+class ChunkedParse
+{
+    std::deque<Rows> parts;
+    std::counting_semaphore<> inFlight;
+    std::jthread decompressor;
+    bool failed;
+
+public:
+    ChunkedParse() :
+    inFlight{2 * std::max<std::ptrdiff_t>(std::thread::hardware_concurrency(), 1)},
+    failed{false}
+    {
+    }
+
+    ChunkedParse(const ChunkedParse&) = delete;
+    ChunkedParse& operator=(const ChunkedParse&) = delete;
+
+    template<typename Parse>
+    void start(QThreadPool &pool, std::string_view data, Parse parse){
+        for(std::string_view chunk : MarketDataParser::splitLines(data, 4 * static_cast<std::size_t>(pool.maxThreadCount()))){
+            Rows *part = &parts.emplace_back();
+            pool.start([chunk, part, parse](){ parse(chunk, *part); });
+        }
+    }
+
+    // Decompresses file on a thread of its own and queues each block on the
+    // pool as soon as it is ready, so reading, decompressing and parsing
+    // overlap. Only a couple of blocks per core are held in memory at once.
+    template<typename Parse>
+    void startCompressed(QThreadPool &pool, const std::string &file, Parse parse){
+        decompressor = std::jthread([this, &pool, file, parse](){
+            CompressedFile compressed(file);
+            auto block = std::make_shared<std::string>();
+            while(compressed.next(*block)){
+                inFlight.acquire();
+                Rows *part = &parts.emplace_back();
+                pool.start([this, block, part, parse](){
+                    parse(*block, *part);
+                    inFlight.release();
+                });
+                block = std::make_shared<std::string>();
+            }
+            failed = compressed.hasFailed();
+        });
+    }
+
+    // True when a compressed file was corrupt or truncated. Only valid once
+    // collect has been called.
+    bool hasFailed() const { return failed; }
+
+    // Only valid once the pool has finished.
+    void collect(QThreadPool &pool, Rows &out){
+        if(decompressor.joinable()){
+            decompressor.join();
+            pool.waitForDone();
+        }
+        std::vector<Rows*> runs;
+        for(auto& part : parts)
+            runs.push_back(&part);
+        appendRows(out, runs);
+        parts.clear();
+    }
+};
+
+// Loads one source file into rows of its own: from its cache when that is up
+// to date, otherwise by parsing it in chunks on the pool. The cache is read on
+// the pool as well, so that the caches of several files are read side by side.
+template<typename Rows>
+class FileLoad
+{
+    std::string file;
+    bool useCache;
+    Rows rows;
+    bool cached;
+    bool collected;
+    std::optional<MappedFile> data;
+    ChunkedParse<Rows> chunks;
+    QThreadPool &pool;
+
+    template<typename Parse>
+    void parse(Parse parse){
+        if(CompressedFile::format(file) != CompressedFile::NONE){
+            chunks.startCompressed(pool, file, parse);
+            return;
+        }
+        data.emplace(file);
+        chunks.start(pool, data->view(), parse);
+    }
+
+public:
+    template<typename Parse>
+    FileLoad(QThreadPool &pool, const std::string &file, bool useCache, Parse parse) :
+    file{file},
+    useCache{useCache},
+    cached{false},
+    collected{false},
+    pool{pool}
+    {
+        if(!useCache){
+            this->parse(parse);
+            return;
+        }
+        pool.start([this, parse](){
+            cached = MarketDataCache::read(this->file, rows);
+            if(!cached)
+                this->parse(parse);
+        });
+    }
+
+    // Only valid once the pool has finished. The rows are collected, and the
+    // cache written, on the first call only.
+    Rows &result(){
+        if(!cached && !collected){
+            collected = true;
+            chunks.collect(pool, rows);
+            // A damaged file loads as nothing, like one that cannot be mapped,
+            // rather than as whatever was read before the damage.
+            if(chunks.hasFailed())
+                rows = Rows();
+            else if(useCache)
+                MarketDataCache::write(file, rows);
+        }
+        return rows;
+    }
+};
+
+// Appends the rows of every file to out so that the result is ordered by time.
+// Files are taken in order of their first row; the whole range is only
+// re-sorted when files overlap.
+template<typename Rows, typename Time>
+static void mergeByTime(std::list<FileLoad<Rows>> &loads, Rows &out, Time time){
+    std::vector<Rows*> runs;
+    for(auto& load : loads){
+        Rows &rows = load.result();
+        if(!rows.empty())
+            runs.push_back(&rows);
+    }
+    std::stable_sort(runs.begin(), runs.end(), [&time](const Rows *a, const Rows *b){
+        return firstTime(*a, time) < firstTime(*b, time);
+    });
+
+    std::size_t start = out.size();
+    appendRows(out, runs);
+    sortByTime(out, start, time);
+}
+
+// A .csv file, plain or compressed (.csv.gz, .csv.zst). The caches written
+// next to them (.csv.rvcache) are not.
+static bool isDataFile(const std::filesystem::path &file){
+    std::filesystem::path name = file.filename();
+    if(CompressedFile::format(name.string()) != CompressedFile::NONE)
+        name = name.stem();
+    return name.extension() == ".csv";
+}
+
+// Directories stand for the data files they contain, in name order.
+static std::vector<std::string> expandDataFiles(const std::vector<std::string> &paths){
+    std::vector<std::string> files;
+    for(const auto& path : paths){
+        if(!std::filesystem::is_directory(path)){
+            files.push_back(path);
+            continue;
+        }
+        std::vector<std::string> directoryFiles;
+        for(const auto& entry : std::filesystem::directory_iterator(path))
+            if(entry.is_regular_file() && isDataFile(entry.path()))
+                directoryFiles.push_back(entry.path().string());
+        std::sort(directoryFiles.begin(), directoryFiles.end());
+        files.insert(files.end(), directoryFiles.begin(), directoryFiles.end());
+    }
+    return files;
+}
+
 void Simulator::loadMarketData(std::ifstream &marketData){
     for(int i = 0; marketData.peek() != EOF; i++){
         Trade trade;
@@ -133,14 +447,25 @@ void Simulator::loadMarketData(std::ifstream &marketData){
         std::getline(marketData, timestamp, ',');
         trade.timestamp = duration_cast<TimePoint>(std::chrono::microseconds(std::stoull(timestamp)));
 
+        std::string isBuyerMaker;
+        std::getline(marketData, isBuyerMaker);
+        trade.isBuyerMaker = !isBuyerMaker.empty() && (isBuyerMaker[0] == 't' || isBuyerMaker[0] == 'T');
         marketHistory.push_back(trade);
-        std::getline(marketData, tradeId);
     }
     loadedMarketData();
 }
 
-void Simulator::loadOrderBookData(std::ifstream &orderBookData){
+void Simulator::loadMarketData(std::string_view marketData){
+    QThreadPool pool;
+    ChunkedParse<TradeColumns> trades;
+    trades.start(pool, marketData, &MarketDataParser::parseTrades);
+    pool.waitForDone();
+    trades.collect(pool, marketHistory);
+    loadedMarketData();
+}
 
+void Simulator::loadOrderBookData(std::ifstream &orderBookData){
+    std::size_t first = orderBooks.size();
     for(int i = 0; orderBookData.peek() != EOF; i++){
         OrderBook orderBook;
 
@@ -156,22 +481,29 @@ void Simulator::loadOrderBookData(std::ifstream &orderBookData){
         std::getline(orderBookData, asks, '\"');
         std::getline(orderBookData, asks, '\"');
         fromJSONString(asks, orderBook.asks);
-        std::sort(orderBook.asks.begin(), orderBook.asks.end(), [](const Order& a, const Order& b) -> bool{
-            return a.price > b.price ? true : false; 
-        });
 
         std::string bids;
         std::getline(orderBookData, bids, '\"');
         std::getline(orderBookData, bids, '\"');
         fromJSONString(bids, orderBook.bids);
-        std::sort(orderBook.bids.begin(), orderBook.bids.end(), [](const Order& a, const Order& b) -> bool{
-            return a.price < b.price ? true : false; 
-        });
+        MarketDataParser::sortLevels(orderBook);
 
         orderBooks.push_back(orderBook);
         
         std::getline(orderBookData, lastUpdateId);
     }
+    storeOrderBookLevels(first);
+    loadedOrderBookData();
+}
+
+void Simulator::loadOrderBookData(std::string_view orderBookData){
+    QThreadPool pool;
+    ChunkedParse<std::vector<OrderBook>> books;
+    books.start(pool, orderBookData, [this](std::string_view chunk, std::vector<OrderBook> &v){ parseOrderBooks(chunk, v); });
+    pool.waitForDone();
+    std::size_t first = orderBooks.size();
+    books.collect(pool, orderBooks);
+    storeOrderBookLevels(first);
     loadedOrderBookData();
 }
 
@@ -180,422 +512,1038 @@ void Simulator::loadHistoricalData(std::ifstream &&marketData, std::ifstream &&o
     loadMarketData(marketData);
 };
 
-void Simulator::loadHistoricalData(std::string marketFile, std::string orderBookFile){
-    loadHistoricalData(std::ifstream(marketFile), std::ifstream(orderBookFile));
+void Simulator::loadHistoricalData(std::string marketFile, std::string orderBookFile, bool useCache){
+    loadHistoricalData(std::vector<std::string>{marketFile}, std::vector<std::string>{orderBookFile}, useCache);
+};
+
+void Simulator::loadHistoricalData(const std::vector<std::string> &marketFiles, const std::vector<std::string> &orderBookFiles, bool useCache){
+    // Every file gets its chunks on the same pool, so all of them are parsed side by side.
+    // Books kept FLAT are parsed straight into arenas, so no snapshot allocates
+    // and the levels are never held twice.
+    QThreadPool pool;
+    std::list<FileLoad<std::vector<OrderBook>>> books;
+    std::list<FileLoad<OrderBookArena>> flatBooks;
+    for(const auto& file : expandDataFiles(orderBookFiles)){
+        if(orderBookStorage == FLAT)
+            flatBooks.emplace_back(pool, file, useCache, [](std::string_view chunk, OrderBookArena &a){ a.parse(chunk); });
+        else
+            books.emplace_back(pool, file, useCache, [this](std::string_view chunk, std::vector<OrderBook> &v){ parseOrderBooks(chunk, v); });
+    }
+    std::list<FileLoad<TradeColumns>> trades;
+    for(const auto& file : expandDataFiles(marketFiles))
+        trades.emplace_back(pool, file, useCache, &MarketDataParser::parseTrades);
+    pool.waitForDone();
+
+    std::size_t first = orderBooks.size();
+    if(orderBookStorage == FLAT){
+        mergeByTime(flatBooks, *flatOrderBooks, [](const OrderBookView &o){ return o.E; });
+        orderBooks.reserve(flatOrderBooks->size());
+        for(std::size_t i = first; i < flatOrderBooks->size(); i++){
+            OrderBookView orderBook = flatOrderBooks->view(i);
+            orderBooks.push_back(OrderBook{orderBook.lastUpdateId, orderBook.E});
+        }
+    }else{
+        mergeByTime(books, orderBooks, [](const OrderBook &o){ return o.E; });
+        storeOrderBookLevels(first);
+    }
+    loadedOrderBookData();
+    mergeByTime(trades, marketHistory, [](const Trade &t){ return t.timestamp; });
+    loadedMarketData();
 };
 
-void Simulator::init(Model *model, Portfolio portfolio, TIMESTEP_MODE tsMode, double makerFee, double takerFee){
-    this->logger = new SimulatorLogger(); 
+void Simulator::streamHistoricalData(std::string marketFile, std::string orderBookFile, std::size_t windowSize){
+    stream = std::make_unique<MarketDataStream>(marketFile, orderBookFile, windowSize);
+}
+
+// With DELTA or FLAT storage orderBooks keeps each snapshot's lastUpdateId and
+// E but no levels; those live in deltaOrderBooks or flatOrderBooks and are
+// looked up when a timestep reaches the snapshot. This moves the levels of the
+// books from first on there.
+void Simulator::storeOrderBookLevels(std::size_t first){
+    if(orderBookStorage == FULL)
+        return;
+    if(orderBookStorage == FLAT){
+        std::size_t levelCount = 0;
+        for(std::size_t i = first; i < orderBooks.size(); i++)
+            levelCount += orderBooks[i].bids.size() + orderBooks[i].asks.size();
+        flatOrderBooks->reserve(orderBooks.size() - first, levelCount);
+    }
+    for(std::size_t i = first; i < orderBooks.size(); i++){
+        if(orderBookStorage == DELTA)
+            deltaOrderBooks->append(orderBooks[i]);
+        else
+            flatOrderBooks->append(orderBooks[i]);
+        orderBooks[i].bids = std::vector<Order>();
+        orderBooks[i].asks = std::vector<Order>();
+    }
+    if(orderBookStorage == DELTA)
+        deltaOrderBooks->shrinkToFit();
+}
+
+// Books loaded while FLAT is set are parsed straight into flatOrderBooks;
+// switching storage afterwards converts what is already loaded.
+void Simulator::setOrderBookStorage(ORDER_BOOK_STORAGE storage){
+    if(storage == orderBookStorage)
+        return;
+    if(orderBookStorage == DELTA){
+        for(std::size_t i = 0; i < orderBooks.size(); i++)
+            orderBooks[i] = deltaOrderBooks->at(i);
+        deltaOrderBooks.reset();
+    }else if(orderBookStorage == FLAT){
+        for(std::size_t i = 0; i < orderBooks.size(); i++)
+            orderBooks[i] = flatOrderBooks->orderBook(i);
+        flatOrderBooks.reset();
+    }
+    if(storage == DELTA)
+        deltaOrderBooks = std::make_unique<DeltaOrderBookStore>();
+    else if(storage == FLAT)
+        flatOrderBooks = std::make_unique<OrderBookArena>();
+    orderBookStorage = storage;
+    storeOrderBookLevels(0);
+}
+
+// Throws std::invalid_argument, before changing anything, for an interval that
+// is not positive, since INTERVAL timesteps could not be cut from it, or for a
+// null model.
+void Simulator::init(Model *model, Portfolio portfolio, TIMESTEP_MODE tsMode, double makerFee, double takerFee, TimePoint interval){
+    if(interval <= TimePoint::zero())
+        throw std::invalid_argument("Simulator::init: the timestep interval must be positive");
+    if(model == nullptr)
+        throw std::invalid_argument("Simulator::init: the model must not be null");
+    delete this->logger;
+    this->logger = new SimulatorLogger(traceLevel == TIMESTEP_TRACE, logDirectory); 
+    if(this->model && this->model != model)
+        this->model->actionPool = nullptr;
     this->model = model;
+    this->model->actionPool = &actionPool;
     this->portfolio = portfolio;
     this->tsMode = tsMode;
+    this->tsInterval = interval;
+    this->lastRunTradeEnd = 0;
+    this->filledSinceRun = false;
+    this->pendingOrders.clear();
+    this->depth.clear();
+    this->queuedTradeEnd = 0;
+    this->inFlight.clear();
+    this->latencyRng.seed(latencySeed);
+    this->lastRunOrderBookId = initialOrderBook.lastUpdateId;
+    this->lastRunOrderBookTime = initialOrderBook.E;
     this->makerFee = makerFee;
     this->takerFee = takerFee;
-    switch(tsMode){
-        case BOTH:
-            timesteps = getBothTimesteps();
-            break;
-        case ORDER_BOOK:
-            timesteps = getOrderBookTimesteps();
-            break;
-        case MARKET:
-            timesteps = getMarketTimesteps();
-    }
-    logger->flush();
+    this->streamedTimes.clear();
     gotTimesteps();
 }
 
-std::vector<Simulator::Timestep> Simulator::getBothTimesteps(){
-    std::vector<Timestep> r{};
-    for(int i = 0, j = 0; i < orderBooks.size() || j < marketHistory.size(); ){
-        TimePoint orderBookTime{TimePoint::max()};
-        TimePoint marketTime{TimePoint::max()};
-        if(i < orderBooks.size())
-            orderBookTime = orderBooks[i].E;
-        if(j < marketHistory.size())
-            marketTime = marketHistory[j].timestamp;
+Simulator::TimestepCursor::TimestepCursor(const Simulator &sim, TIMESTEP_MODE mode) :
+sim{sim},
+mode{mode},
+i{0},
+j{0},
+t{TimePoint::zero()},
+orderBook{&initialOrderBook},
+bookIndex{-1}
+{
+}
+
+// End of the interval that contains time. Intervals are aligned to multiples
+// of interval since the epoch.
+static TimePoint intervalEnd(TimePoint time, TimePoint interval){
+    return (time / interval + 1) * interval;
+}
 
+// Each mode only looks at the events that can end its timesteps: ORDER_BOOK
+// never tests for a trade event, MARKET never tests for a book transition.
+// INTERVAL ends a timestep at the end of each interval holding an event; the
+// timestep sees every trade and the latest book from before that end.
+template<Simulator::TIMESTEP_MODE Mode>
+bool Simulator::TimestepCursor::advance(){
+    const std::vector<OrderBook> &orderBooks = sim.orderBooks;
+    const std::vector<TimePoint> &tradeTimes = sim.marketHistory.timestamps;
+    if constexpr(Mode == BOTH){
+        if(i == orderBooks.size() && j == tradeTimes.size())
+            return false;
+        TimePoint orderBookTime{i < orderBooks.size() ? orderBooks[i].E : TimePoint::max()};
+        TimePoint marketTime{j < tradeTimes.size() ? tradeTimes[j] : TimePoint::max()};
         if(orderBookTime > marketTime){
             j++;
-            r.push_back(Timestep(
-                marketTime, 
-                MarketHistory{std::span(marketHistory).subspan(0, j)},
-                (i-1 >= 0 ? orderBooks[i-1] : initialOrderBook)));
-            logger->logTimestep(marketTime, j, i-1);
+            t = marketTime;
+            return true;
         }
-        else{    //TODO: consider the case orderBookTime == marketTime
-            i++;
-            r.push_back(Timestep(
-                orderBookTime, 
-                MarketHistory{std::span(marketHistory).subspan(0, j)},
-                orderBooks[i-1]));
-            logger->logTimestep(orderBookTime, j, i-1);
+        //TODO: consider the case orderBookTime == marketTime
+        t = orderBookTime;
+    }else if constexpr(Mode == ORDER_BOOK){
+        if(i == orderBooks.size())
+            return false;
+        t = orderBooks[i].E;
+        if(j < tradeTimes.size() && t > tradeTimes[j]){
+            while(j < tradeTimes.size() && tradeTimes[j] <= t)
+                j++;
         }
+    }else if constexpr(Mode == MARKET){
+        if(j == tradeTimes.size())
+            return false;
+        TimePoint marketTime{tradeTimes[j]};
+        j++;
+        t = marketTime + TimePoint(1);
+        if(i == orderBooks.size() || marketTime < orderBooks[i].E)
+            return true;
+        while(i + 1 < orderBooks.size() && orderBooks[i + 1].E <= marketTime)
+            i++;
+    }else{
+        if(i == orderBooks.size() && j == tradeTimes.size())
+            return false;
+        TimePoint orderBookTime{i < orderBooks.size() ? orderBooks[i].E : TimePoint::max()};
+        TimePoint marketTime{j < tradeTimes.size() ? tradeTimes[j] : TimePoint::max()};
+        t = intervalEnd(std::min(orderBookTime, marketTime), sim.tsInterval);
+        while(j < tradeTimes.size() && tradeTimes[j] < t)
+            j++;
+        if(orderBookTime >= t)
+            return true;
+        while(i + 1 < orderBooks.size() && orderBooks[i + 1].E < t)
+            i++;
     }
+    // move to the book at index i
+    bookIndex = static_cast<int>(i);
+    orderBook = &orderBooks[i];
+    i++;
+    return true;
+}
+
+bool Simulator::TimestepCursor::next(){
+    switch(mode){
+        case BOTH: return advance<BOTH>();
+        case ORDER_BOOK: return advance<ORDER_BOOK>();
+        case MARKET: return advance<MARKET>();
+        default: return advance<INTERVAL>();
+    }
+}
+
+MarketHistory Simulator::TimestepCursor::market() const {
+    return MarketHistory{TradeView(sim.marketHistory, 0, j)};
+}
+
+std::vector<Simulator::Timestep> Simulator::getTimesteps(TIMESTEP_MODE mode){
+    std::vector<Timestep> r{};
+    for(TimestepCursor cursor(*this, mode); cursor.next(); )
+        r.push_back(cursor.current());
     return r;
 }
 
+std::vector<Simulator::Timestep> Simulator::getBothTimesteps(){
+    return getTimesteps(BOTH);
+}
+
 std::vector<Simulator::Timestep> Simulator::getOrderBookTimesteps(){
+    return getTimesteps(ORDER_BOOK);
+}
 
-    std::vector<Timestep> r{};
-    for(int i = 0, j = 0; i < orderBooks.size(); i++){
-        TimePoint orderBookTime{orderBooks[i].E};
-        TimePoint marketTime{TimePoint::max()};
-        if(j < marketHistory.size())
-        marketTime = marketHistory[j].timestamp;
+std::vector<Simulator::Timestep> Simulator::getMarketTimesteps(){
+    return getTimesteps(MARKET);
+}
 
-        if(orderBookTime > marketTime){
-            while(j < marketHistory.size() && marketHistory[j].timestamp <= orderBookTime)
-                j++;
-        }
+// Takes effect at the next init.
+void Simulator::setTraceLevel(TRACE_LEVEL level){
+    traceLevel = level;
+}
+
+void Simulator::setFillModel(FILL_MODEL model){
+    fillModel = model;
+}
 
-        r.push_back(Timestep(
-            orderBookTime, 
-            MarketHistory{std::span(marketHistory).subspan(0, j)},
-            orderBooks[i]));
-        logger->logTimestep(orderBookTime, j, i);
+void Simulator::setLimitFillModel(LIMIT_FILL_MODEL model){
+    limitFillModel = model;
+}
+
+// Orders take order to reach the exchange and cancels take cancel. Actions
+// are also decided on market data that is marketData old, which delays them
+// the same way, so it is added to their trip.
+void Simulator::setLatency(Latency order, Latency cancel, Latency marketData, unsigned seed){
+    orderLatency = order;
+    cancelLatency = cancel;
+    marketDataLatency = marketData;
+    hasLatency = false;
+    for(const Latency &latency : {order, cancel, marketData})
+        hasLatency = hasLatency || latency.fixed != TimePoint::zero() || latency.jitter != TimePoint::zero();
+    latencySeed = seed;
+}
+
+// Writes the timesteps of mode as a flat array of TimestepIndexEntry, the
+// same information TIMESTEP_TRACE logs, without running a model.
+bool Simulator::writeTimestepIndex(const std::string &path, TIMESTEP_MODE mode){
+    QSaveFile file(QString::fromStdString(path));
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    std::vector<TimestepIndexEntry> buffer;
+    buffer.reserve(1 << 16);
+    auto writeBuffer = [&](){
+        qint64 bytes = static_cast<qint64>(buffer.size() * sizeof(TimestepIndexEntry));
+        bool written = file.write(reinterpret_cast<const char*>(buffer.data()), bytes) == bytes;
+        buffer.clear();
+        return written;
+    };
+    for(TimestepCursor cursor(*this, mode); cursor.next(); ){
+        buffer.push_back(TimestepIndexEntry{cursor.time().count(), cursor.orderBookIndex(), static_cast<std::uint32_t>(cursor.marketHistoryIndex())});
+        if(buffer.size() == buffer.capacity() && !writeBuffer())
+            return false;
     }
-    return r;
+    return writeBuffer() && file.commit();
 }
 
-std::vector<Simulator::Timestep> Simulator::getMarketTimesteps(){
-    std::vector<Timestep> r{};
-    for(int i = 0, j = 0; i < orderBooks.size() || j < marketHistory.size(); ){
-        TimePoint orderBookTime{TimePoint::max()};
-        TimePoint marketTime{TimePoint::max()};
-        if(i < orderBooks.size())
-        orderBookTime = orderBooks[i].E;
-        if(j < marketHistory.size())
-        marketTime = marketHistory[j].timestamp;
+// By default the model sees every trade since the start of the data. With a
+// lookback it sees the trades added since its last call plus up to lookback
+// trades before them.
+void Simulator::setMarketHistoryLookback(std::size_t trades){
+    marketHistoryLookback = trades;
+}
 
-        if(marketTime > orderBookTime){
-            while(i < orderBooks.size() && orderBooks[i].E <= marketTime)
-                i++;
+// Exact for ORDER_BOOK and MARKET, an upper bound for BOTH and INTERVAL.
+std::size_t Simulator::timestepCountHint() const {
+    switch(tsMode){
+        case ORDER_BOOK: return orderBooks.size();
+        case MARKET: return marketHistory.size();
+        case INTERVAL:{
+            if(orderBooks.empty() && marketHistory.empty())
+                return 0;
+            TimePoint first{TimePoint::max()};
+            TimePoint last{TimePoint::min()};
+            if(!orderBooks.empty()){
+                first = orderBooks.front().E;
+                last = orderBooks.back().E;
+            }
+            if(!marketHistory.empty()){
+                first = std::min(first, marketHistory.front().timestamp);
+                last = std::max(last, marketHistory.back().timestamp);
+            }
+            std::size_t intervals = static_cast<std::size_t>((last - first) / tsInterval) + 1;
+            return std::min(intervals, orderBooks.size() + marketHistory.size());
         }
+        default: return orderBooks.size() + marketHistory.size();
+    }
+}
 
-        marketTime++;
+// Fills quantity of a resting limit order whose filled already counts it.
+void Simulator::fillPendingLimit(TimePoint t, const LimitOrder &lo, double quantity){
+    SimulatorLogger::ActionState state = lo.filled < lo.quantity ? SimulatorLogger::PartiallyFilled : SimulatorLogger::Processed;
+    if(lo.actionType == BUY){
+        portfolio.pendingMoney -= quantity * lo.price;
+        portfolio.authQuantity += quantity * (1-makerFee);
+        logger->logAction(t, state, lo, quantity * (1-makerFee), lo.price, quantity * lo.price);
+        notifyFill(t, ActionType::BUY);
+    }else{
+        portfolio.pendingQuantity -= quantity;
+        portfolio.authMoney += quantity * lo.price * (1-makerFee);
+        logger->logAction(t, state, lo, quantity, lo.price, quantity * lo.price * (1-makerFee));
+        notifyFill(t, ActionType::SELL);
+    }
+}
 
-        r.push_back(Timestep(
-            marketTime, 
-            MarketHistory{std::span(marketHistory).subspan(0, j)},
-            orderBooks[i-1]));
-        logger->logTimestep(marketTime, j, i-1);
+void Simulator::fillPendingStop(const Timestep &ts, const StopOrder &so){
+    if(so.actionType == BUY){
+        double total{so.quantity * so.price};
+        BookDepth::Fill fill = marketFillFor(ts, total);
+        portfolio.pendingMoney -= total;
+        portfolio.authMoney += total - fill.notional;
+        portfolio.authQuantity += fill.quantity * (1-takerFee);
+        logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(fill.notional, total), so, fill.quantity * (1-takerFee), fill.price, fill.notional);
+        notifyFill(std::get<0>(ts), ActionType::BUY);
+    }else{
+        BookDepth::Fill fill = marketFill(ts, SELL, so.quantity);
+        portfolio.pendingQuantity -= so.quantity;
+        portfolio.authQuantity += so.quantity - fill.quantity;
+        portfolio.authMoney += fill.notional * (1-takerFee);
+        logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(fill.quantity, so.quantity), so, fill.quantity, fill.price, fill.notional * (1-takerFee));
+        notifyFill(std::get<0>(ts), ActionType::SELL);
     }
-    return r;
-};
+}
 
+// Only the orders the last trade price reaches are visited. With
+// QUEUE_POSITION, limit orders are left to processQueuedLimits.
 void Simulator::processPendingActions(const Timestep &ts){
-    int i = 0;
-    while(i < pendingActions.size()){
-        const Action &action = *pendingActions[i];
-        switch (action.index())
-        {
-        case Action::typeIndex<LimitOrder>():{
-            const LimitOrder &lo = static_cast<const LimitOrder&>(action);
-            if(lo.actionType == BUY && std::get<1>(ts).trades.back().price <= lo.price){
-                portfolio.pendingMoney -= lo.quantity * lo.price;
-                portfolio.authQuantity += lo.quantity * (1-makerFee);
-                logger->logAction(std::get<0>(ts), SimulatorLogger::ActionState::Processed, lo, lo.quantity * (1-makerFee), lo.price, lo.quantity * lo.price);
-                emit orderFilled(std::get<0>(ts), ActionType::BUY);
-            }else if(lo.actionType == SELL && std::get<1>(ts).trades.back().price >= lo.price){
-                portfolio.pendingQuantity -= lo.quantity;
-                portfolio.authMoney += lo.quantity * lo.price * (1-makerFee);
-                logger->logAction(std::get<0>(ts), SimulatorLogger::ActionState::Processed, lo, lo.quantity, lo.price, lo.quantity * lo.price * (1-makerFee));
-                emit orderFilled(std::get<0>(ts), ActionType::SELL);
-            }else break;
-            delete &lo;
-            pendingActions.erase(pendingActions.begin()+i);
-            break;
-        }case Action::typeIndex<StopOrder>():{
-            const StopOrder &so = static_cast<const StopOrder&>(action);
-            if(so.actionType == BUY && std::get<1>(ts).trades.back().price >= so.price){
-                double total{so.quantity * so.price};
-                portfolio.pendingMoney -= total;
-                portfolio.authQuantity += total / std::get<1>(ts).trades.back().price * (1-takerFee);
-                logger->logAction(std::get<0>(ts), SimulatorLogger::ActionState::Processed, so, total / std::get<1>(ts).trades.back().price * (1-takerFee), std::get<1>(ts).trades.back().price, total);
-                emit orderFilled(std::get<0>(ts), ActionType::BUY);
-            }else if(so.actionType == SELL && std::get<1>(ts).trades.back().price <= so.price){
-                portfolio.pendingQuantity -= so.quantity;
-                portfolio.authMoney += so.quantity * std::get<1>(ts).trades.back().price * (1-takerFee);
-                logger->logAction(std::get<0>(ts), SimulatorLogger::ActionState::Processed, so, so.quantity, std::get<1>(ts).trades.back().price, so.quantity * std::get<1>(ts).trades.back().price * (1-takerFee));
-                emit orderFilled(std::get<0>(ts), ActionType::SELL);
-            }else break;
-            delete &so;
-            pendingActions.erase(pendingActions.begin()+i);
-            break;
-        }default:
-            break;
-        }
-        i++;
+    auto fill = [&](auto &order){
+        using T = std::decay_t<decltype(order)>;
+        if constexpr(std::is_same_v<T, LimitOrder>){
+            double quantity = order.quantity - order.filled;
+            order.filled = order.quantity;
+            fillPendingLimit(std::get<0>(ts), order, quantity);
+        }else
+            fillPendingStop(ts, order);
+    };
+    if(limitFillModel == QUEUE_POSITION)
+        pendingOrders.triggerStops(tradePrice, fill);
+    else
+        pendingOrders.trigger(tradePrice, fill);
+}
+
+// Matches the resting limit orders against each trade that arrived since the
+// last call, so every trade is looked at once however many timesteps see it.
+void Simulator::processQueuedLimits(const Timestep &ts){
+    TradeView trades = std::get<1>(ts).trades;
+    std::size_t end = historyBase + trades.size();
+    if(limitFillModel == QUEUE_POSITION && pendingOrders.hasLimits()){
+        auto fill = [&](const LimitOrder &lo, double quantity){ fillPendingLimit(std::get<0>(ts), lo, quantity); };
+        for(std::size_t k = std::max(queuedTradeEnd, historyBase) - historyBase; k < trades.size(); k++)
+            pendingOrders.match(trades[k], fill);
     }
+    queuedTradeEnd = end;
+}
+
+// Quantity resting ahead of a new limit order at its price, from the order
+// book it is placed against.
+double Simulator::queueAhead(const Timestep &ts, const LimitOrder &lo){
+    if(limitFillModel != QUEUE_POSITION)
+        return 0;
+    return bookDepth(std::get<2>(ts)).levelQuantity(lo.actionType, lo.price);
 }
 
 void Simulator::processMarketOrder(const Timestep &ts, MarketOrder &mo){
-    logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Awaiting, mo);
     if(mo.actionType == BUY){
-        double total {mo.quantity * std::get<1>(ts).trades.back().price};
-        if(!(0 <= mo.quantity && total <= portfolio.authMoney)){
+        if(!(0 <= mo.quantity)){
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, mo);
-            delete &mo;
             return;
         }
-        portfolio.authMoney -= total;
-        portfolio.authQuantity += mo.quantity * (1-takerFee);
-        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, mo, mo.quantity * (1-takerFee), std::get<1>(ts).trades.back().price, total);
-        emit orderFilled(std::get<0>(ts), ActionType::BUY);
-        delete &mo;
+        BookDepth::Fill fill = marketFill(ts, BUY, mo.quantity);
+        if(!(fill.notional <= portfolio.authMoney)){
+            logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, mo);
+            return;
+        }
+        portfolio.authMoney -= fill.notional;
+        portfolio.authQuantity += fill.quantity * (1-takerFee);
+        logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(fill.quantity, mo.quantity), mo, fill.quantity * (1-takerFee), fill.price, fill.notional);
+        notifyFill(std::get<0>(ts), ActionType::BUY);
     }else if(mo.actionType == SELL){
         if(!(0 <= mo.quantity && mo.quantity <= portfolio.authQuantity)){
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, mo);
-            delete &mo;
             return;
         }
-        portfolio.authQuantity -= mo.quantity;
-        portfolio.authMoney += mo.quantity * std::get<1>(ts).trades.back().price * (1-takerFee);
-        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, mo, mo.quantity, std::get<1>(ts).trades.back().price, mo.quantity * std::get<1>(ts).trades.back().price * (1-takerFee));
-        emit orderFilled(std::get<0>(ts), ActionType::SELL);
-        delete &mo;
+        BookDepth::Fill fill = marketFill(ts, SELL, mo.quantity);
+        portfolio.authQuantity -= fill.quantity;
+        portfolio.authMoney += fill.notional * (1-takerFee);
+        logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(fill.quantity, mo.quantity), mo, fill.quantity, fill.price, fill.notional * (1-takerFee));
+        notifyFill(std::get<0>(ts), ActionType::SELL);
     }    
 }
 
 void Simulator::processLimitOrder(const Timestep &ts, LimitOrder& lo){
-    logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Awaiting, lo);
     if(lo.actionType == BUY){
         double total {lo.quantity * lo.price};
         if(!(0 <= lo.quantity && 0 <= lo.price && total <= portfolio.authMoney)){
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, lo);
-            delete &lo;
             return;
         }
-        if(!(std::get<1>(ts).trades.back().price <= lo.price)){
+        if(!(tradePrice <= lo.price)){
             portfolio.authMoney -= total;
             portfolio.pendingMoney += total;
             lo.actionId = nextActionId; nextActionId++;
-            pendingActions.push_back(&lo);
+            lo.queueAhead = queueAhead(ts, lo);
+            pendingOrders.insert(lo);
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Pending, lo);
             return;
         }
         portfolio.authMoney -= total;
         portfolio.authQuantity += lo.quantity * (1-takerFee);
         logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, lo, lo.quantity * (1-takerFee), lo.price, total);
-        emit orderFilled(std::get<0>(ts), ActionType::BUY);
-        delete &lo;
+        notifyFill(std::get<0>(ts), ActionType::BUY);
     }else if(lo.actionType == SELL){
         if(!(0 <= lo.quantity && 0 <= lo.price && lo.quantity <= portfolio.authQuantity)){
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, lo);
-            delete &lo;
             return;
         }
-        if(!(std::get<1>(ts).trades.back().price >= lo.price)){
+        if(!(tradePrice >= lo.price)){
             portfolio.authQuantity -= lo.quantity;
             portfolio.pendingQuantity += lo.quantity;
             lo.actionId = nextActionId; nextActionId++;
-            pendingActions.push_back(&lo);
+            lo.queueAhead = queueAhead(ts, lo);
+            pendingOrders.insert(lo);
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Pending, lo);
             return;
         }
         portfolio.authQuantity -= lo.quantity;
         portfolio.authMoney += lo.quantity * lo.price * (1-takerFee);
         logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, lo, lo.quantity, lo.price, lo.quantity * lo.price * (1-takerFee));
-        emit orderFilled(std::get<0>(ts), ActionType::SELL);
-        delete &lo;
+        notifyFill(std::get<0>(ts), ActionType::SELL);
     }
 }
 
 void Simulator::processStopOrder(const Timestep &ts, StopOrder &so){
-    logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Awaiting, so);
     if(so.actionType == BUY){
         double total {so.quantity * so.price};
         if(!(0 <= so.quantity && 0 <= so.price && total <= portfolio.authMoney)){
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, so);
-            delete &so;
             return;
         }
-        if(!(std::get<1>(ts).trades.back().price >= so.price)){
+        if(!(tradePrice >= so.price)){
             portfolio.authMoney -= total;
             portfolio.pendingMoney += total;
             so.actionId = nextActionId; nextActionId++;
-            pendingActions.push_back(&so);
+            pendingOrders.insert(so);
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Pending, so);
             return;
         }
-        portfolio.authMoney -= total;
-        portfolio.authQuantity += total / std::get<1>(ts).trades.back().price * (1-takerFee);
-        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, so, total / std::get<1>(ts).trades.back().price * (1-takerFee), std::get<1>(ts).trades.back().price, total);
-        emit orderFilled(std::get<0>(ts), ActionType::BUY);
-        delete &so;
+        BookDepth::Fill fill = marketFillFor(ts, total);
+        portfolio.authMoney -= fill.notional;
+        portfolio.authQuantity += fill.quantity * (1-takerFee);
+        logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(fill.notional, total), so, fill.quantity * (1-takerFee), fill.price, fill.notional);
+        notifyFill(std::get<0>(ts), ActionType::BUY);
     }else if(so.actionType == SELL){
         if(!(0 <= so.quantity && 0 <= so.price && so.quantity <= portfolio.authQuantity)){
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, so);
-            delete &so;
             return;
         }
-        if(!(std::get<1>(ts).trades.back().price <= so.price)){
+        if(!(tradePrice <= so.price)){
             portfolio.authQuantity -= so.quantity;
             portfolio.pendingQuantity += so.quantity;
             so.actionId = nextActionId; nextActionId++;
-            pendingActions.push_back(&so);
+            pendingOrders.insert(so);
             logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Pending, so);
             return;
         }
-        portfolio.authQuantity -= so.quantity;
-        portfolio.authMoney += so.quantity * std::get<1>(ts).trades.back().price * (1-takerFee);
-        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, so, so.quantity, std::get<1>(ts).trades.back().price, so.quantity * std::get<1>(ts).trades.back().price * (1-takerFee));
-        emit orderFilled(std::get<0>(ts), ActionType::SELL);
-        delete &so;
+        BookDepth::Fill fill = marketFill(ts, SELL, so.quantity);
+        portfolio.authQuantity -= fill.quantity;
+        portfolio.authMoney += fill.notional * (1-takerFee);
+        logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(fill.quantity, so.quantity), so, fill.quantity, fill.price, fill.notional * (1-takerFee));
+        notifyFill(std::get<0>(ts), ActionType::SELL);
     }
 }
 
 void Simulator::processCancel(const Timestep &ts, Cancel &c){
-    auto cit = std::find_if(pendingActions.begin(), pendingActions.end(), 
-        [&c](const Action* a){return c.orderId == a->actionId;});
-    const Action &cancelledAction{**cit};
-    if(cit == pendingActions.end()){
+    std::optional<ActionValue> cancelled = pendingOrders.erase(c.orderId);
+    if(!cancelled){
         logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, c);
-        delete &c;
         return;
     }
-    if(cancelledAction.index() == Action::typeIndex<LimitOrder>()){
-        const LimitOrder &lo = static_cast<const LimitOrder&>(cancelledAction);
-        if(lo.actionType == BUY){
-            double total {lo.quantity * lo.price};
+    if(const LimitOrder *lo = std::get_if<LimitOrder>(&*cancelled)){
+        double remaining {lo->quantity - lo->filled};
+        if(lo->actionType == BUY){
+            double total {remaining * lo->price};
             portfolio.authMoney += total;
             portfolio.pendingMoney -= total;
-        }else if(lo.actionType == SELL){
-            portfolio.authQuantity += lo.quantity;
-            portfolio.pendingQuantity -= lo.quantity;
-        }
-        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Cancelled, lo);
-    }else if(cancelledAction.index() == Action::typeIndex<StopOrder>()){
-        const StopOrder &so = static_cast<const StopOrder&>(cancelledAction);
-        if(so.actionType == BUY){
-            double total {so.quantity * so.price};
+        }else if(lo->actionType == SELL){
+            portfolio.authQuantity += remaining;
+            portfolio.pendingQuantity -= remaining;
+        }
+        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Cancelled, *lo);
+    }else if(const StopOrder *so = std::get_if<StopOrder>(&*cancelled)){
+        if(so->actionType == BUY){
+            double total {so->quantity * so->price};
             portfolio.authMoney += total;
             portfolio.pendingMoney -= total;
-        }else if(so.actionType == SELL){
-            portfolio.authQuantity += so.quantity;
-            portfolio.pendingQuantity -= so.quantity;
+        }else if(so->actionType == SELL){
+            portfolio.authQuantity += so->quantity;
+            portfolio.pendingQuantity -= so->quantity;
         }
-        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Cancelled, so);
+        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Cancelled, *so);
     }
-    delete &cancelledAction;
-    pendingActions.erase(cit);
     logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, c);
-    delete &c;
 }
 
-void Simulator::processAction(const Timestep &ts, Action* action){
-    switch (action->index())
+// Moves the money or quantity set aside for the order by the change, so an
+// amend costs what a cancel and a new order would without losing the order.
+void Simulator::processAmend(const Timestep &ts, Amend &a){
+    const Action *order = pendingOrders.find(a.orderId);
+    if(!order || !(0 <= a.price)){
+        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, a);
+        return;
+    }
+    ActionType side;
+    double filled {0};
+    double change;
+    if(order->index() == Action::typeIndex<LimitOrder>()){
+        const LimitOrder &lo = static_cast<const LimitOrder&>(*order);
+        side = lo.actionType;
+        filled = lo.filled;
+        change = side == BUY ? (a.quantity - filled) * a.price - (lo.quantity - filled) * lo.price : a.quantity - lo.quantity;
+    }else{
+        const StopOrder &so = static_cast<const StopOrder&>(*order);
+        side = so.actionType;
+        change = side == BUY ? a.quantity * a.price - so.quantity * so.price : a.quantity - so.quantity;
+    }
+    if(!(filled < a.quantity && change <= (side == BUY ? portfolio.authMoney : portfolio.authQuantity))){
+        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Error, a);
+        return;
+    }
+    if(side == BUY){
+        portfolio.authMoney -= change;
+        portfolio.pendingMoney += change;
+    }else{
+        portfolio.authQuantity -= change;
+        portfolio.pendingQuantity += change;
+    }
+    if(order->index() == Action::typeIndex<LimitOrder>()){
+        LimitOrder amended = static_cast<const LimitOrder&>(*order);
+        amended.price = a.price;
+        pendingOrders.amend(a.orderId, a.quantity, a.price, queueAhead(ts, amended));
+        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Amended, static_cast<const LimitOrder&>(*pendingOrders.find(a.orderId)));
+    }else{
+        pendingOrders.amend(a.orderId, a.quantity, a.price);
+        logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Amended, static_cast<const StopOrder&>(*pendingOrders.find(a.orderId)));
+    }
+    logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Processed, a);
+}
+
+void Simulator::execute(const Timestep &ts, ActionValue &action){
+    std::visit([&](auto &a){
+        using T = std::decay_t<decltype(a)>;
+        if constexpr(std::is_same_v<T, MarketOrder>)
+            processMarketOrder(ts, a);
+        else if constexpr(std::is_same_v<T, LimitOrder>)
+            processLimitOrder(ts, a);
+        else if constexpr(std::is_same_v<T, StopOrder>)
+            processStopOrder(ts, a);
+        else if constexpr(std::is_same_v<T, Cancel>)
+            processCancel(ts, a);
+        else
+            processAmend(ts, a);
+    }, action);
+}
+
+void Simulator::processAction(const Timestep &ts, ActionValue &action){
+    std::visit([&](auto &a){
+        using T = std::decay_t<decltype(a)>;
+        if constexpr(!std::is_same_v<T, Cancel> && !std::is_same_v<T, Amend>)
+            logger->logAction(std::get<0>(ts), Simulator::SimulatorLogger::Awaiting, a);
+    }, action);
+    execute(ts, action);
+}
+
+// Crosses the opposing market orders of run, a stretch of consecutive market
+// orders of actionBatch, with each other at the last trade price, as buying
+// and selling the same quantity at that price would, so only what is left of
+// them walks the book. Returns whether anything was crossed.
+bool Simulator::crossMarketOrders(const Timestep &ts, std::span<ActionValue> run){
+    double buys {0}, sells {0};
+    for(const ActionValue &action : run){
+        const MarketOrder &mo = std::get<MarketOrder>(action);
+        if(0 < mo.quantity)
+            (mo.actionType == BUY ? buys : sells) += mo.quantity;
+    }
+    double crossed = std::min(buys, sells);
+    if(!(0 < crossed && crossed <= portfolio.authQuantity && crossed * tradePrice * takerFee <= portfolio.authMoney))
+        return false;
+    double buying {crossed}, selling {crossed};
+    for(ActionValue &action : run){
+        MarketOrder &mo = std::get<MarketOrder>(action);
+        if(!(0 < mo.quantity))
+            continue;
+        double &left = mo.actionType == BUY ? buying : selling;
+        double quantity = std::min(left, mo.quantity);
+        if(quantity == 0)
+            continue;
+        left -= quantity;
+        if(mo.actionType == BUY){
+            portfolio.authMoney -= quantity * tradePrice;
+            portfolio.authQuantity += quantity * (1-takerFee);
+            logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(quantity, mo.quantity), mo, quantity * (1-takerFee), tradePrice, quantity * tradePrice);
+        }else{
+            portfolio.authQuantity -= quantity;
+            portfolio.authMoney += quantity * tradePrice * (1-takerFee);
+            logger->logAction(std::get<0>(ts), SimulatorLogger::fillState(quantity, mo.quantity), mo, quantity, tradePrice, quantity * tradePrice * (1-takerFee));
+        }
+        notifyFill(std::get<0>(ts), mo.actionType);
+        mo.quantity -= quantity;
+    }
+    return true;
+}
+
+// Processes the actions that reach the exchange at one timestep together,
+// with a single log row for all of them, in the order they were sent. Market
+// orders sent one after the other are crossed with each other first, and
+// those crossed completely are done. Crossing never reaches past another
+// action, so no order overtakes a cancel, amend or order sent before it. Each
+// action is checked against the portfolio as it is executed, as an earlier
+// cancel or sell can pay for a later order.
+void Simulator::processBatch(const Timestep &ts){
+    if(actionBatch.size() == 1){
+        processAction(ts, actionBatch.front());
+    }else if(!actionBatch.empty()){
+        logger->logBatch(std::get<0>(ts), actionBatch.size());
+        auto isMarketOrder = [](const ActionValue &action){ return std::holds_alternative<MarketOrder>(action); };
+        for(auto action = actionBatch.begin(); action != actionBatch.end(); ){
+            if(!isMarketOrder(*action)){
+                execute(ts, *action++);
+                continue;
+            }
+            auto runEnd = std::find_if_not(action, actionBatch.end(), isMarketOrder);
+            bool crossed = crossMarketOrders(ts, std::span<ActionValue>(action, runEnd));
+            for(; action != runEnd; ++action)
+                if(!crossed || 0 < std::get<MarketOrder>(*action).quantity)
+                    execute(ts, *action);
+        }
+    }
+    actionBatch.clear();
+}
+
+TimePoint Simulator::sampleLatency(const Latency &latency){
+    if(latency.jitter == TimePoint::zero())
+        return latency.fixed;
+    std::exponential_distribution<double> jitter(1.0 / latency.jitter.count());
+    return latency.fixed + TimePoint(std::llround(jitter(latencyRng)));
+}
+
+// Adds an action the model just returned to this timestep's batch, or, with
+// latency, sends it to arrive at a later timestep.
+void Simulator::dispatch(const Timestep &ts, ActionValue &action){
+    if(!hasLatency){
+        actionBatch.push_back(std::move(action));
+        return;
+    }
+    const Latency &leg = std::holds_alternative<Cancel>(action) ? cancelLatency : orderLatency;
+    TimePoint arrival = std::get<0>(ts) + sampleLatency(marketDataLatency) + sampleLatency(leg);
+    inFlight.push_back(InFlight{arrival, inFlightSequence++, std::move(action)});
+    std::push_heap(inFlight.begin(), inFlight.end(), InFlight::arrivesAfter);
+}
+
+// Processes the actions that arrived by this timestep, in arrival order.
+void Simulator::processArrivals(const Timestep &storedTs){
+    if(inFlight.front().arrival > std::get<0>(storedTs))
+        return;
+    Timestep ts(std::get<0>(storedTs), std::get<1>(storedTs), resolveOrderBook(std::get<2>(storedTs)));
+    while(!inFlight.empty() && inFlight.front().arrival <= std::get<0>(ts)){
+        std::pop_heap(inFlight.begin(), inFlight.end(), InFlight::arrivesAfter);
+        actionBatch.push_back(std::move(inFlight.back().action));
+        inFlight.pop_back();
+    }
+    processBatch(ts);
+}
+
+// Index of orderBook in orderBooks, or -1 for initialOrderBook and streamed books.
+std::ptrdiff_t Simulator::orderBookIndex(const OrderBook &orderBook) const {
+    std::less<const OrderBook*> before;
+    if(before(&orderBook, orderBooks.data()) || !before(&orderBook, orderBooks.data() + orderBooks.size()))
+        return -1;
+    return &orderBook - orderBooks.data();
+}
+
+const OrderBook &Simulator::resolveOrderBook(const OrderBook &orderBook){
+    std::ptrdiff_t i = deltaOrderBooks ? orderBookIndex(orderBook) : -1;
+    return i < 0 ? orderBook : deltaOrderBooks->at(i);
+}
+
+// Copies an action a model returned by pointer, then frees it.
+ActionValue Simulator::takeAction(Action *action){
+    auto copy = [](const Action &action) -> ActionValue {
+        switch(action.index())
+        {
+        case Action::typeIndex<MarketOrder>(): return static_cast<const MarketOrder&>(action);
+        case Action::typeIndex<LimitOrder>(): return static_cast<const LimitOrder&>(action);
+        case Action::typeIndex<StopOrder>(): return static_cast<const StopOrder&>(action);
+        case Action::typeIndex<Cancel>(): return static_cast<const Cancel&>(action);
+        default: return static_cast<const Amend&>(action);
+        }
+    };
+    ActionValue value = copy(*action);
+    release(*action);
+    std::visit([](Action &a){ a.pooled = false; }, value);
+    return value;
+}
+
+// Frees an action a model returned by pointer, whether it was made from the
+// pool or with new.
+void Simulator::release(const Action &action){
+    if(action.pooled){
+        actionPool.release(&action);
+        return;
+    }
+    switch(action.index())
     {
-    case Action::typeIndex<MarketOrder>(): processMarketOrder(ts, static_cast<MarketOrder&>(*action)); break;
-    case Action::typeIndex<LimitOrder>(): processLimitOrder(ts, static_cast<LimitOrder&>(*action)); break;
-    case Action::typeIndex<StopOrder>(): processStopOrder(ts, static_cast<StopOrder&>(*action)); break;
-    case Action::typeIndex<Cancel>(): processCancel(ts, static_cast<Cancel&>(*action)); break;
+    case Action::typeIndex<MarketOrder>(): delete &static_cast<const MarketOrder&>(action); break;
+    case Action::typeIndex<LimitOrder>(): delete &static_cast<const LimitOrder&>(action); break;
+    case Action::typeIndex<StopOrder>(): delete &static_cast<const StopOrder&>(action); break;
+    case Action::typeIndex<Cancel>(): delete &static_cast<const Cancel&>(action); break;
+    case Action::typeIndex<Amend>(): delete &static_cast<const Amend&>(action); break;
     default:
         break;
     }
 }
 
+// Depth of orderBook, as given in a Timestep, worked out once per snapshot.
+const BookDepth &Simulator::bookDepth(const OrderBook &orderBook){
+    if(depth.holds(orderBook.lastUpdateId, orderBook.E))
+        return depth;
+    std::ptrdiff_t i = flatOrderBooks ? orderBookIndex(orderBook) : -1;
+    if(i >= 0){
+        OrderBookView view = flatOrderBooks->view(i);
+        depth.assign(view.lastUpdateId, view.E, view.bids, view.asks);
+    }else{
+        const OrderBook &levels = resolveOrderBook(orderBook);
+        depth.assign(levels.lastUpdateId, levels.E, levels.bids, levels.asks);
+    }
+    return depth;
+}
+
+// Fill of a market order for quantity. An empty side of the book fills at
+// the last trade price, like LAST_TRADE.
+BookDepth::Fill Simulator::marketFill(const Timestep &ts, ActionType side, double quantity){
+    if(fillModel == BOOK_DEPTH){
+        const BookDepth &book = bookDepth(std::get<2>(ts));
+        if(side == BUY && book.hasAsks())
+            return book.buy(quantity);
+        if(side == SELL && book.hasBids())
+            return book.sell(quantity);
+    }
+    return BookDepth::Fill{quantity, quantity * tradePrice, tradePrice};
+}
+
+// Fill of a market buy that spends at most money.
+BookDepth::Fill Simulator::marketFillFor(const Timestep &ts, double money){
+    if(fillModel == BOOK_DEPTH){
+        const BookDepth &book = bookDepth(std::get<2>(ts));
+        if(book.hasAsks())
+            return book.buyFor(money);
+    }
+    return BookDepth::Fill{money / tradePrice, money, tradePrice};
+}
+
+void Simulator::notifyFill(TimePoint t, ActionType type){
+    filledSinceRun = true;
+    emit orderFilled(t, type);
+}
+
+bool Simulator::wakesModel(const Timestep &ts) const {
+    const WakeConditions &wake = model->wakeConditions();
+    if(wake.everyTimestep || (wake.onFill && filledSinceRun) || std::get<0>(ts) >= wake.at)
+        return true;
+    const OrderBook &orderBook = std::get<2>(ts);
+    if(wake.onOrderBook && (orderBook.lastUpdateId != lastRunOrderBookId || orderBook.E != lastRunOrderBookTime))
+        return true;
+    std::span<const double> prices = std::get<1>(ts).prices();
+    return !prices.empty() && (prices.back() >= wake.priceAtOrAbove || prices.back() <= wake.priceAtOrBelow);
+}
+
+MarketHistory Simulator::marketWindow(const MarketHistory &market) const {
+    std::size_t end = historyBase + market.trades.size();
+    std::size_t previousEnd = std::min(lastRunTradeEnd, end);
+    std::size_t start = previousEnd - std::min(previousEnd, marketHistoryLookback);
+    start = std::max(start, historyBase) - historyBase;
+    return MarketHistory{market.trades.subspan(start), end - previousEnd};
+}
+
+void Simulator::step(const Timestep &storedTs){
+    tradePrice = std::get<1>(storedTs).prices().back();
+    processQueuedLimits(storedTs);
+    if(!inFlight.empty())
+        processArrivals(storedTs);
+    if(wakesModel(storedTs)){
+        Timestep ts(std::get<0>(storedTs), std::get<1>(storedTs), resolveOrderBook(std::get<2>(storedTs)));
+        MarketHistory market = marketWindow(std::get<1>(ts));
+        std::ptrdiff_t flatIndex = flatOrderBooks ? orderBookIndex(std::get<2>(ts)) : -1;
+        actionBuffer.clear();
+        if(flatIndex < 0)
+            model->run(portfolio, pendingOrders.resting(), market, std::get<2>(ts), actionBuffer);
+        else
+            model->run(portfolio, pendingOrders.resting(), market, flatOrderBooks->view(flatIndex), actionBuffer);
+        lastRunTradeEnd = historyBase + std::get<1>(ts).trades.size();
+        filledSinceRun = false;
+        lastRunOrderBookId = std::get<2>(ts).lastUpdateId;
+        lastRunOrderBookTime = std::get<2>(ts).E;
+        for(auto& action : model->submitted)
+            dispatch(ts, action);
+        model->submitted.clear();
+        for(auto& action : actionBuffer){
+            ActionValue value = takeAction(action);
+            dispatch(ts, value);
+        }
+        processBatch(ts);
+    }
+    processPendingActions(storedTs);
+    if(stream)
+        streamedTimes.push_back(std::get<0>(storedTs));
+    portfolioValue.push_back(
+        portfolio.authMoney + portfolio.pendingMoney +
+        ( portfolio.authQuantity + portfolio.pendingQuantity ) * tradePrice);
+    logger->logPortfolio(std::get<0>(storedTs), portfolio, portfolioValue.back());
+    portfolioValueUpdated();
+}
+
 std::vector<double> Simulator::run(){
-    portfolioValue.reserve(timesteps.size());
-    for(const auto& ts : timesteps){
-        std::vector<Action*> actions = model
-            ->run(portfolio, pendingActions, std::get<1>(ts), std::get<2>(ts));
-        for(auto& action : actions)
-            processAction(ts, action);
-        processPendingActions(ts);
-        portfolioValue.push_back(
-            portfolio.authMoney + portfolio.pendingMoney +
-            ( portfolio.authQuantity + portfolio.pendingQuantity ) * std::get<1>(ts).trades.back().price);
-        logger->logPortfolio(std::get<0>(ts), portfolio, portfolioValue.back());
-        portfolioValueUpdated();
+    switch(tsMode){
+        case BOTH: return stream ? runStream<BOTH>() : run<BOTH>();
+        case ORDER_BOOK: return stream ? runStream<ORDER_BOOK>() : run<ORDER_BOOK>();
+        case MARKET: return stream ? runStream<MARKET>() : run<MARKET>();
+        default: return stream ? runStream<INTERVAL>() : run<INTERVAL>();
+    }
+}
+
+template<Simulator::TIMESTEP_MODE Mode>
+std::vector<double> Simulator::run(){
+    historyBase = 0;
+    portfolioValue.reserve(timestepCountHint());
+    bool traceTimesteps = logger->tracesTimesteps();
+    for(TimestepCursor cursor(*this, Mode); cursor.advance<Mode>(); ){
+        if(traceTimesteps)
+            logger->logTimestep(cursor.time(), cursor.marketHistoryIndex(), cursor.orderBookIndex());
+        step(cursor.current());
     }
     logger->flush();
     return portfolioValue;
 }
 
-std::vector<double> Simulator::best(){
-    std::vector<double> best{portfolio.authMoney};
-    best.reserve(timesteps.size());
-    for(auto it = timesteps.begin(); it != timesteps.end()-1; ++it){
-        if(std::get<1>(*it).trades.empty()){
-            best.push_back(best.back());
-            continue;
+// Builds the same timesteps as TimestepCursor, but from the stream. The model
+// sees the last windowSize trades (up to twice that between compactions)
+// instead of the whole history.
+template<Simulator::TIMESTEP_MODE Mode>
+std::vector<double> Simulator::runStream(){
+    TradeColumns window;
+    window.reserve(2 * stream->windowSize());
+    OrderBook orderBook{initialOrderBook};
+    historyBase = 0;
+    auto appendTrade = [&](const Trade &trade){
+        if(window.size() == 2 * stream->windowSize()){
+            historyBase += window.size() - stream->windowSize();
+            window.eraseFront(window.size() - stream->windowSize());
+        }
+        window.push_back(trade);
+        stream->popTrade();
+    };
+
+    for(;;){
+        if constexpr(Mode == BOTH){
+            const Trade *trade = stream->peekTrade();
+            OrderBook *nextOrderBook = stream->peekOrderBook();
+            if(!trade && !nextOrderBook)
+                break;
+            TimePoint marketTime{trade ? trade->timestamp : TimePoint::max()};
+            TimePoint orderBookTime{nextOrderBook ? nextOrderBook->E : TimePoint::max()};
+            if(orderBookTime > marketTime){
+                appendTrade(*trade);
+                step(Timestep(marketTime, MarketHistory{window}, orderBook));
+            }else{
+                orderBook = std::move(*nextOrderBook);
+                stream->popOrderBook();
+                step(Timestep(orderBookTime, MarketHistory{window}, orderBook));
+            }
+        }else if constexpr(Mode == ORDER_BOOK){
+            OrderBook *nextOrderBook = stream->peekOrderBook();
+            if(!nextOrderBook)
+                break;
+            TimePoint orderBookTime{nextOrderBook->E};
+            for(const Trade *trade = stream->peekTrade(); trade && trade->timestamp <= orderBookTime; trade = stream->peekTrade())
+                appendTrade(*trade);
+            orderBook = std::move(*nextOrderBook);
+            stream->popOrderBook();
+            step(Timestep(orderBookTime, MarketHistory{window}, orderBook));
+        }else if constexpr(Mode == MARKET){
+            const Trade *trade = stream->peekTrade();
+            if(!trade)
+                break;
+            TimePoint marketTime{trade->timestamp};
+            for(OrderBook *nextOrderBook = stream->peekOrderBook(); nextOrderBook && nextOrderBook->E <= marketTime; nextOrderBook = stream->peekOrderBook()){
+                orderBook = std::move(*nextOrderBook);
+                stream->popOrderBook();
+            }
+            appendTrade(*trade);
+            step(Timestep(marketTime + TimePoint(1), MarketHistory{window}, orderBook));
+        }else{
+            const Trade *trade = stream->peekTrade();
+            OrderBook *nextOrderBook = stream->peekOrderBook();
+            if(!trade && !nextOrderBook)
+                break;
+            TimePoint marketTime{trade ? trade->timestamp : TimePoint::max()};
+            TimePoint orderBookTime{nextOrderBook ? nextOrderBook->E : TimePoint::max()};
+            TimePoint end = intervalEnd(std::min(orderBookTime, marketTime), tsInterval);
+            for(; trade && trade->timestamp < end; trade = stream->peekTrade())
+                appendTrade(*trade);
+            for(; nextOrderBook && nextOrderBook->E < end; nextOrderBook = stream->peekOrderBook()){
+                orderBook = std::move(*nextOrderBook);
+                stream->popOrderBook();
+            }
+            step(Timestep(end, MarketHistory{window}, orderBook));
         }
-        double nextPrice = std::get<1>(*(it+1)).trades.back().price;
-        double currentPrice = std::get<1>(*it).trades.back().price;
-        if(currentPrice <= nextPrice)
-            best.push_back((best.back()/currentPrice)*nextPrice);
-        else
-            best.push_back(best.back());
-            
     }
-    return best;
+    // A damaged file ends the stream early, which must not pass for the end of the data.
+    bool failed = stream->hasFailed();
+    stream.reset();
+    logger->flush();
+    if(failed)
+        throw std::runtime_error("Simulator::run: the streamed market data is corrupt or truncated");
+    return portfolioValue;
 }
 
-std::vector<double> Simulator::worst(){
-    std::vector<double> worst{portfolio.authMoney};
-    worst.reserve(timesteps.size());
-    for(auto it = timesteps.begin(); it != timesteps.end()-1; ++it){
-        if(std::get<1>(*it).trades.empty()){
-            worst.push_back(worst.back());
-            continue;
+// Portfolio value of a strategy that, between consecutive timesteps, either
+// holds everything in the asset or in money as decided by choose(currentPrice, nextPrice).
+template<typename Choose>
+std::vector<double> Simulator::referenceValues(Choose choose){
+    std::vector<double> values{portfolio.authMoney};
+    values.reserve(timestepCountHint());
+    TimestepCursor cursor(*this, tsMode);
+    if(!cursor.next())
+        return values;
+    MarketHistory current = cursor.market();
+    while(cursor.next()){
+        MarketHistory next = cursor.market();
+        if(current.trades.empty()){
+            values.push_back(values.back());
+        }else{
+            double nextPrice = next.prices().back();
+            double currentPrice = current.prices().back();
+            if(choose(currentPrice, nextPrice))
+                values.push_back((values.back()/currentPrice)*nextPrice);
+            else
+                values.push_back(values.back());
         }
-        double nextPrice = std::get<1>(*(it+1)).trades.back().price;
-        double currentPrice = std::get<1>(*it).trades.back().price;
-        if(currentPrice >= nextPrice)
-            worst.push_back((worst.back()/currentPrice)*nextPrice);
-        else
-            worst.push_back(worst.back());
+        current = next;
     }
-    return worst;
+    return values;
+}
+
+std::vector<double> Simulator::best(){
+    return referenceValues([](double currentPrice, double nextPrice){ return currentPrice <= nextPrice; });
+}
+
+std::vector<double> Simulator::worst(){
+    return referenceValues([](double currentPrice, double nextPrice){ return currentPrice >= nextPrice; });
 }
 
 std::vector<double> Simulator::random(){
-    std::vector<double> worst{portfolio.authMoney};
-    worst.reserve(timesteps.size());
     std::srand(std::time({}));
-    for(auto it = timesteps.begin(); it != timesteps.end()-1; ++it){
-        if(std::get<1>(*it).trades.empty()){
-            worst.push_back(worst.back());
-            continue;
+    return referenceValues([](double, double){ return std::rand()%2 < 1; });
+}
+
+// Sums with four independent accumulators so the loop can be vectorized
+// without reassociating a single running sum.
+static double sum(std::span<const double> values){
+    double s[4]{};
+    std::size_t i = 0;
+    for(; i + 4 <= values.size(); i += 4){
+        s[0] += values[i];
+        s[1] += values[i + 1];
+        s[2] += values[i + 2];
+        s[3] += values[i + 3];
+    }
+    for(; i < values.size(); i++)
+        s[0] += values[i];
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+static double sumOfSquaredDeviations(std::span<const double> values, double mean){
+    double s[4]{};
+    std::size_t i = 0;
+    for(; i + 4 <= values.size(); i += 4){
+        for(int k = 0; k < 4; k++){
+            double d = values[i + k] - mean;
+            s[k] += d * d;
         }
-        double nextPrice = std::get<1>(*(it+1)).trades.back().price;
-        double currentPrice = std::get<1>(*it).trades.back().price;
-        if(std::rand()%2 < 1)
-            worst.push_back((worst.back()/currentPrice)*nextPrice);
-        else
-            worst.push_back(worst.back());
     }
-    return worst;
+    for(; i < values.size(); i++){
+        double d = values[i] - mean;
+        s[0] += d * d;
+    }
+    return (s[0] + s[1]) + (s[2] + s[3]);
 }
 
 double Simulator::getPriceMean(){
-    double mean = 0;
-    for(const auto& t: marketHistory)
-        mean += t.price;
-    return mean / marketHistory.size();
+    return sum(marketHistory.prices) / marketHistory.size();
 }
 
 double Simulator::getPriceStdDev(){
-    double stdDev = 0;
     double mean = getPriceMean();
-    for(const auto& t: marketHistory)
-        stdDev += std::pow((mean - t.price), 2);
-    return std::sqrt(stdDev / (marketHistory.size()-1));
+    return std::sqrt(sumOfSquaredDeviations(marketHistory.prices, mean) / (marketHistory.size()-1));
 }
 
 double Simulator::getQuantityMean(){
-    double mean = 0;
-    for(const auto& t: marketHistory)
-        mean += t.quantity;
-    return mean / marketHistory.size();
+    return sum(marketHistory.quantities) / marketHistory.size();
 }
 
 double Simulator::getQuantityStdDev(){
-    double stdDev = 0;
     double mean = getQuantityMean();
-    for(const auto& t: marketHistory)
-        stdDev += std::pow((mean - t.quantity), 2);
-    return std::sqrt(stdDev / (marketHistory.size()-1));
-}
\ No newline at end of file
+    return std::sqrt(sumOfSquaredDeviations(marketHistory.quantities, mean) / (marketHistory.size()-1));
+}
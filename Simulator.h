@@ -1,18 +1,22 @@
 #pragma once
 
 #include "Model.h"
+#include "BookDepth.h"
+#include "PendingOrders.h"
+#include "RevivalGlobal.h"
 #include <string>
+#include <string_view>
+#include <cstdint>
 #include <QObject>
 #include <QList>
 #include <QDateTime>
 #include <memory>
+#include <random>
 #include "spdlog/spdlog.h"
 
-#if defined(REVIVAL_LIBRARY)
-# define REVIVAL_API Q_DECL_EXPORT
-#else
-# define REVIVAL_API Q_DECL_IMPORT
-#endif
+class MarketDataStream;
+class DeltaOrderBookStore;
+class OrderBookArena;
 
 class REVIVAL_API Simulator : public QObject
 {
@@ -28,6 +32,8 @@ class REVIVAL_API Simulator : public QObject
             Pending,
             Cancelled,
             Error,
+            PartiallyFilled,
+            Amended,
         };
     private:
         std::shared_ptr<spdlog::logger> timestepLogger;
@@ -35,7 +41,12 @@ class REVIVAL_API Simulator : public QObject
         std::shared_ptr<spdlog::logger> portfolioLogger;
         static const char *actionStateString(ActionState s);
     public:
-        SimulatorLogger();
+        // Logs to dirPath, or to the Logs folder next to the executable.
+        explicit SimulatorLogger(bool traceTimesteps = false, std::string dirPath = std::string());
+        ~SimulatorLogger();
+        // Processed, or PartiallyFilled when the book ran out before wanted.
+        static ActionState fillState(double filled, double wanted) { return filled < wanted ? PartiallyFilled : Processed; }
+        bool tracesTimesteps() const { return timestepLogger != nullptr; }
         void logTimestep(TimePoint t, int marketHistoryIndex, int orderBookIndex);
         void logAction(TimePoint t, ActionState s, const MarketOrder &mo);
         void logAction(TimePoint t, ActionState s, const MarketOrder &mo, double processedPrice, double processedQuantity, double total);
@@ -44,6 +55,8 @@ class REVIVAL_API Simulator : public QObject
         void logAction(TimePoint t, ActionState s, const StopOrder &so);
         void logAction(TimePoint t, ActionState s, const StopOrder &so, double processedPrice, double processedQuantity, double total);
         void logAction(TimePoint t, ActionState s, const Cancel &c);
+        void logAction(TimePoint t, ActionState s, const Amend &a);
+        void logBatch(TimePoint t, std::size_t actions);
         void logPortfolio(TimePoint t, const Portfolio &p, double value);
         void flush();
     };
@@ -52,50 +65,198 @@ public:
     enum TIMESTEP_MODE {
         BOTH,
         ORDER_BOOK,
-        MARKET
+        MARKET,
+        INTERVAL // one timestep per interval that has trades or order books
+    };
+
+    // Delay of one leg of an action's trip: fixed, plus, when jitter is not
+    // zero, a random part drawn from an exponential distribution with mean
+    // jitter.
+    struct Latency
+    {
+        TimePoint fixed = TimePoint::zero();
+        TimePoint jitter = TimePoint::zero();
+    };
+
+    enum ORDER_BOOK_STORAGE {
+        FULL,
+        DELTA,
+        FLAT
+    };
+
+    enum TRACE_LEVEL {
+        NO_TRACE,
+        TIMESTEP_TRACE // also log every timestep to the timesteps CSV
+    };
+
+    // One record of the binary timestep index written by writeTimestepIndex.
+    struct TimestepIndexEntry
+    {
+        std::int64_t time;
+        std::int32_t orderBookIndex; // -1 before the first order book
+        std::uint32_t marketHistoryIndex; // number of trades visible
+    };
+
+    // Price that market orders and triggered stop orders get.
+    enum FILL_MODEL {
+        LAST_TRADE, // everything at the last trade price
+        BOOK_DEPTH // walk the order book, partially filling when it runs out
+    };
+
+    // When resting limit orders fill.
+    enum LIMIT_FILL_MODEL {
+        TOUCH, // as soon as the last trade price reaches the limit
+        QUEUE_POSITION // once trades at the limit used up the quantity that was ahead
     };
 
 private:
+    // Produces the timesteps of a TIMESTEP_MODE one at a time from the loaded
+    // order books and trades, so they never have to be stored.
+    class TimestepCursor {
+        const Simulator &sim;
+        TIMESTEP_MODE mode;
+        std::size_t i; // order books reached
+        std::size_t j; // trades reached
+        TimePoint t;
+        const OrderBook *orderBook;
+        int bookIndex;
+    public:
+        TimestepCursor(const Simulator &sim, TIMESTEP_MODE mode);
+        // Moves to the next timestep. Returns false when there is none.
+        bool next();
+        // Same as next, for a cursor created with Mode.
+        template<TIMESTEP_MODE Mode>
+        bool advance();
+        TimePoint time() const { return t; }
+        MarketHistory market() const;
+        Timestep current() const { return Timestep(t, market(), *orderBook); }
+        int marketHistoryIndex() const { return static_cast<int>(j); }
+        int orderBookIndex() const { return bookIndex; }
+    };
 
     SimulatorLogger *logger;
+    std::string logDirectory; // where init puts the logs, the default of SimulatorLogger when empty
 
     static const OrderBook initialOrderBook;
     static int nextActionId;
 
     Portfolio portfolio;
-    std::vector<const Action*> pendingActions; //faster if it is std::vector instead of std::list, probably due to way more cache hits
+    PendingOrders pendingOrders; // resting limit and stop orders, by side and price
+    ActionPool actionPool;
+    std::vector<Action*> actionBuffer; // filled by model->run, reused every timestep
+    std::vector<ActionValue> actionBatch; // actions reaching the exchange at the current timestep
+    double tradePrice; // last trade price of the current timestep
     Model *model;
     TIMESTEP_MODE tsMode;
+    TimePoint tsInterval; // timestep length in INTERVAL mode
+    TRACE_LEVEL traceLevel;
 
     std::vector<OrderBook> orderBooks;
-    std::vector<Trade> marketHistory;
-    std::vector<Timestep> timesteps;
+    TradeColumns marketHistory;
+    std::unique_ptr<MarketDataStream> stream;
+    ORDER_BOOK_STORAGE orderBookStorage;
+    std::unique_ptr<DeltaOrderBookStore> deltaOrderBooks; // levels of orderBooks when DELTA
+    std::unique_ptr<OrderBookArena> flatOrderBooks; // levels of orderBooks when FLAT
     double makerFee;
     double takerFee;
+    FILL_MODEL fillModel;
+    BookDepth depth; // of the last order book a fill walked
+    LIMIT_FILL_MODEL limitFillModel;
+    std::size_t queuedTradeEnd; // trades matched against resting limit orders
+    std::size_t marketHistoryLookback; // trades before the new ones that the model sees
+    std::size_t historyBase; // number of trades dropped before the first one in the current MarketHistory
+    std::size_t lastRunTradeEnd; // trades seen at the last model->run call
+    bool filledSinceRun; // an order filled since model->run was last called
+    long long lastRunOrderBookId; // lastUpdateId of the book at that call
+    TimePoint lastRunOrderBookTime;
+
+    // An action on its way to the exchange.
+    struct InFlight
+    {
+        TimePoint arrival;
+        std::uint64_t sequence; // keeps actions arriving together in the order they were sent
+        ActionValue action;
+        static bool arrivesAfter(const InFlight &a, const InFlight &b){
+            return a.arrival != b.arrival ? a.arrival > b.arrival : a.sequence > b.sequence;
+        }
+    };
+
+    Latency orderLatency;
+    Latency cancelLatency;
+    Latency marketDataLatency;
+    bool hasLatency;
+    unsigned latencySeed;
+    std::mt19937_64 latencyRng;
+    std::vector<InFlight> inFlight; // heap, first to arrive at the front
+    std::uint64_t inFlightSequence;
 
     std::vector<double> portfolioValue;
+    std::vector<TimePoint> streamedTimes; // of the timesteps of a streamed run, which cannot be replayed
 
     void fromJSONString(std::string &str, std::vector<Order> &v);
+    void parseOrderBooks(std::string_view orderBookData, std::vector<OrderBook> &books);
     void loadMarketData(std::ifstream &market);
+    void loadMarketData(std::string_view marketData);
     void loadOrderBookData(std::ifstream &orderBookData);
+    void loadOrderBookData(std::string_view orderBookData);
 
+    std::vector<Timestep> getTimesteps(TIMESTEP_MODE mode);
     std::vector<Timestep> getBothTimesteps();
     std::vector<Timestep> getOrderBookTimesteps();
     std::vector<Timestep> getMarketTimesteps();
+    std::size_t timestepCountHint() const;
+    template<typename Choose>
+    std::vector<double> referenceValues(Choose choose);
 
     void processMarketOrder(const Timestep &ts, MarketOrder &mo);
     void processLimitOrder(const Timestep &ts, LimitOrder &lo);
     void processStopOrder(const Timestep &ts, StopOrder &so);
     void processCancel(const Timestep &ts, Cancel &c);
-    void processAction(const Timestep &ts, Action *action);
+    void processAmend(const Timestep &ts, Amend &a);
+    void execute(const Timestep &ts, ActionValue &action);
+    void processAction(const Timestep &ts, ActionValue &action);
+    bool crossMarketOrders(const Timestep &ts, std::span<ActionValue> run);
+    void processBatch(const Timestep &ts);
+    TimePoint sampleLatency(const Latency &latency);
+    void dispatch(const Timestep &ts, ActionValue &action);
+    void processArrivals(const Timestep &storedTs);
+    void fillPendingLimit(TimePoint t, const LimitOrder &lo, double quantity);
+    void fillPendingStop(const Timestep &ts, const StopOrder &so);
     void processPendingActions(const Timestep &ts);
+    void processQueuedLimits(const Timestep &ts);
+    double queueAhead(const Timestep &ts, const LimitOrder &lo);
+    const BookDepth &bookDepth(const OrderBook &orderBook);
+    BookDepth::Fill marketFill(const Timestep &ts, ActionType side, double quantity);
+    BookDepth::Fill marketFillFor(const Timestep &ts, double money);
+    void notifyFill(TimePoint t, ActionType type);
+    void release(const Action &action);
+    ActionValue takeAction(Action *action);
+    bool wakesModel(const Timestep &ts) const;
+    MarketHistory marketWindow(const MarketHistory &market) const;
+    void storeOrderBookLevels(std::size_t first);
+    std::ptrdiff_t orderBookIndex(const OrderBook &orderBook) const;
+    const OrderBook &resolveOrderBook(const OrderBook &orderBook);
+    void step(const Timestep &storedTs);
+    template<TIMESTEP_MODE Mode>
+    std::vector<double> run();
+    template<TIMESTEP_MODE Mode>
+    std::vector<double> runStream();
 
 public:
     Simulator();
     ~Simulator();
     void loadHistoricalData(std::ifstream &&marketData, std::ifstream &&orderBookData);
-    void loadHistoricalData(std::string marketFile, std::string orderBookFile);
-    void init(Model *model, Portfolio = Portfolio{1000, 0}, TIMESTEP_MODE tsMode = ORDER_BOOK, double makerFee = 0.001, double takerFee = 0.001);
+    void loadHistoricalData(std::string marketFile, std::string orderBookFile, bool useCache = false);
+    void loadHistoricalData(const std::vector<std::string> &marketFiles, const std::vector<std::string> &orderBookFiles, bool useCache = false);
+    void streamHistoricalData(std::string marketFile, std::string orderBookFile, std::size_t windowSize = 1 << 20);
+    void setOrderBookStorage(ORDER_BOOK_STORAGE storage);
+    void setTraceLevel(TRACE_LEVEL level);
+    void setFillModel(FILL_MODEL model);
+    void setLimitFillModel(LIMIT_FILL_MODEL model);
+    void setLatency(Latency order, Latency cancel, Latency marketData, unsigned seed = 0);
+    void setMarketHistoryLookback(std::size_t trades);
+    bool writeTimestepIndex(const std::string &path, TIMESTEP_MODE mode);
+    void init(Model *model, Portfolio = Portfolio{1000, 0}, TIMESTEP_MODE tsMode = ORDER_BOOK, double makerFee = 0.001, double takerFee = 0.001, TimePoint interval = TimePoint(1000));
     std::vector<double> run();
     void reset();
     std::vector<double> best();
@@ -29,7 +29,13 @@ ui{new Ui::Simulator}
     marketHistPlot->setInteraction(QCP::iRangeZoom, true);
     
     QObject::connect(runButton, &QPushButton::clicked, [this](bool checked){
-        QThreadPool::globalInstance()->start([this](){sim->run();});
+        QThreadPool::globalInstance()->start([this](){
+            try{
+                sim->run();
+            }catch(const std::exception &e){
+                qWarning("%s", e.what());
+            }
+        });
     });
     QObject::connect(sim, &Simulator::portfolioValueUpdated, this, &SimulatorUI::plotPortfolioValue);
     QObject::connect(sim, &Simulator::orderFilled, this, &SimulatorUI::plotOrder, Qt::QueuedConnection);
@@ -41,9 +47,10 @@ void SimulatorUI::plotMarketHistory(){
     QVector<double> y;
     x.reserve(sim->marketHistory.size());
     y.reserve(sim->marketHistory.size());
-    for(const auto& t: sim->marketHistory){
-        x.append(t.timestamp.count());
-        y.append(t.price);
+    const TradeColumns &trades = sim->marketHistory;
+    for(std::size_t i = 0; i < trades.size(); i++){
+        x.append(trades.timestamps[i].count());
+        y.append(trades.prices[i]);
     }
     double maxY = *std::max_element(y.begin(), y.end());
     double minY = *std::min_element(y.begin(), y.end());
@@ -54,6 +61,13 @@ void SimulatorUI::plotMarketHistory(){
 }
 
 void SimulatorUI::plotBWR(){
+    // A streamed run has no prices ahead of time to compute the references
+    // from. Their graphs stay empty so that the portfolio is still graph 3.
+    if(sim->stream){
+        for(int i = 0; i < 3; i++)
+            portfValuePlot->addGraph();
+        return;
+    }
     QVector<double> x;
     std::vector<double> bv = sim->best();
     QVector<double> best{bv.begin(), bv.end()};
@@ -61,9 +75,8 @@ void SimulatorUI::plotBWR(){
     QVector<double> worst{wv.begin(), wv.end()};
     std::vector<double> rv = sim->random();
     QVector<double> random{rv.begin(), rv.end()};
-    for(const auto& ts: sim->timesteps){
-        x.append(std::get<0>(ts).count());
-    }
+    for(Simulator::TimestepCursor cursor(*sim, sim->tsMode); cursor.next(); )
+        x.append(cursor.time().count());
 
     double maxY = *std::max_element(best.begin(), best.end());
     double minY = *std::min_element(worst.begin(), worst.end());
@@ -86,13 +99,24 @@ void SimulatorUI::plotPortfolioValue(){
     QVector<double> y;
     x.reserve(sim->portfolioValue.size());
     y.reserve(x.capacity());
-    for(int i = 0; i<sim->portfolioValue.size(); i++){
-        x.push_back(std::get<0>(sim->timesteps[i]).count());
-        y.push_back(sim->portfolioValue[i]);
+    if(!sim->streamedTimes.empty()){
+        for(int i = 0; i<sim->portfolioValue.size() && i<sim->streamedTimes.size(); i++){
+            x.push_back(sim->streamedTimes[i].count());
+            y.push_back(sim->portfolioValue[i]);
+        }
+    }else{
+        Simulator::TimestepCursor cursor(*sim, sim->tsMode);
+        for(int i = 0; i<sim->portfolioValue.size() && cursor.next(); i++){
+            x.push_back(cursor.time().count());
+            y.push_back(sim->portfolioValue[i]);
+        }
     }
 
     portfValuePlot->graph(3)->setData(x, y);
     portfValuePlot->graph(3)->setPen(QPen(Qt::black));
+    // Without the references nothing else set the ranges.
+    if(!sim->streamedTimes.empty())
+        portfValuePlot->rescaleAxes();
     portfValuePlot->replot(QCustomPlot::rpQueuedReplot);
 }
 
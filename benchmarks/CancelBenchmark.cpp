@@ -0,0 +1,136 @@
+#define Simulator() Simulator(); friend int CancelBenchmark(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+struct NumberedLimit : LimitOrder
+{
+    NumberedLimit(int id, ActionType actionType, double quantity, double price) : LimitOrder(actionType, quantity, price){
+        actionId = id;
+    }
+};
+
+// Places one limit order per call until orders of them rest, then on every
+// call cancels a random one and places a replacement.
+class MarketMakerModel : public Model
+{
+    std::mt19937 rng{7};
+    std::size_t orders;
+    std::size_t calls = 0;
+
+public:
+    explicit MarketMakerModel(std::size_t orders) : orders(orders) {}
+
+    std::vector<Action *> run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions,
+               const MarketHistory &market, const OrderBook &orderBook) override {
+        return {};
+    }
+
+    void run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions,
+               const MarketHistory &market, const OrderBook &orderBook, std::vector<Action *> &out) override {
+        if(pendingActions.size() >= orders)
+            out.push_back(make<Cancel>(pendingActions[rng() % pendingActions.size()]->getId()));
+        double level = 1 + rng() % (orders / 2);
+        out.push_back(calls++ % 2 ? make<LimitOrder>(SELL, 1, 1000 + level * 0.1) : make<LimitOrder>(BUY, 1, 1000 - level * 0.1));
+    }
+};
+
+template<typename F>
+double timeNs(F f){
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+// Usage: CommonBenchmarks CancelBenchmark [ticks] [orders]
+//
+// A market-making model with a fixed number of resting limit orders (10000 by
+// default) that cancels a random one and places a replacement on every tick.
+// Compares PendingOrders::erase, which looks the order up by id, with finding
+// it by a scan of every resting order, and times the same cancel and replace
+// made by a model, through Simulator::step and processBatch.
+int CancelBenchmark(int argc, char* argv[]){
+    std::size_t ticks = argc > 1 ? std::stoul(argv[1]) : 100000;
+    int orders = argc > 2 ? std::stoi(argv[2]) : 10000;
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> level(1, orders / 2);
+    std::uniform_int_distribution<int> pick(0, orders - 1);
+
+    PendingOrders pending;
+    std::vector<LimitOrder> scanned;
+    std::vector<int> resting; // ids, to pick the cancelled one from
+    int nextId = 1;
+    for(int i = 0; i < orders; i++, nextId++){
+        NumberedLimit lo(nextId, i % 2 ? SELL : BUY, 1, i % 2 ? 1000 + level(rng) * 0.1 : 1000 - level(rng) * 0.1);
+        pending.insert(lo);
+        scanned.push_back(lo);
+        resting.push_back(nextId);
+    }
+
+    std::vector<std::pair<std::size_t, NumberedLimit>> plan;
+    plan.reserve(ticks);
+    for(std::size_t t = 0; t < ticks; t++, nextId++){
+        ActionType side = t % 2 ? SELL : BUY;
+        plan.emplace_back(pick(rng), NumberedLimit(nextId, side, 1, side == SELL ? 1000 + level(rng) * 0.1 : 1000 - level(rng) * 0.1));
+    }
+
+    std::vector<int> indexedIds = resting;
+    std::size_t cancelled = 0;
+    double indexed = timeNs([&](){
+        for(const auto &[slot, replacement] : plan){
+            cancelled += pending.erase(indexedIds[slot]).has_value();
+            pending.insert(replacement);
+            indexedIds[slot] = replacement.getId();
+        }
+    });
+
+    std::vector<int> scannedIds = resting;
+    std::size_t scanCancelled = 0;
+    double scan = timeNs([&](){
+        for(const auto &[slot, replacement] : plan){
+            int id = scannedIds[slot];
+            auto it = std::find_if(scanned.begin(), scanned.end(), [id](const LimitOrder &lo){ return lo.getId() == id; });
+            if(it != scanned.end()){
+                scanned.erase(it);
+                scanCancelled++;
+            }
+            scanned.push_back(replacement);
+            scannedIds[slot] = replacement.getId();
+        }
+    });
+
+    MarketMakerModel model(orders); // outlives sim, which hands it its action pool
+    Simulator sim;
+    sim.logDirectory = (std::filesystem::temp_directory_path() / "revival-logs" / "").string();
+    sim.init(&model, Portfolio{1e12, 0, 1e12, 0}, Simulator::ORDER_BOOK, 0, 0);
+    TradeColumns trades{Trade{1, 1000, 1, TimePoint(1)}};
+    OrderBook orderBook{1, TimePoint(1), {{999.9, 1}}, {{1000.1, 1}}};
+    Simulator::Timestep ts(TimePoint(1), MarketHistory{trades}, orderBook);
+    for(int i = 0; i < orders; i++)
+        sim.step(ts);
+    double stepped = timeNs([&](){
+        for(std::size_t t = 0; t < ticks; t++)
+            sim.step(ts);
+    });
+    bool replaced = sim.pendingOrders.size() == static_cast<std::size_t>(orders);
+
+    std::cout << orders << " resting orders, " << ticks << " cancels: "
+              << "by id " << indexed / ticks << " ns, "
+              << "scan " << scan / ticks << " ns, "
+              << "step " << stepped / ticks << " ns per cancel and replace"
+              << (cancelled == ticks && scanCancelled == ticks && replaced ? "" : " (missed cancels)") << std::endl;
+    return cancelled == ticks && scanCancelled == ticks && replaced ? 0 : 1;
+}
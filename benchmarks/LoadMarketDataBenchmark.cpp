@@ -0,0 +1,70 @@
+#define Simulator() Simulator(); friend int LoadMarketDataBenchmark(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+#include "..\MappedFile.h"
+
+#undef Simulator
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+template<typename F>
+static long long timeMs(F f){
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Usage: CommonBenchmarks LoadMarketDataBenchmark <aggTrades.csv> [orderBook.csv]
+int LoadMarketDataBenchmark(int argc, char* argv[]){
+    if(argc < 2){
+        std::cerr << "usage: LoadMarketDataBenchmark <aggTrades.csv> [orderBook.csv]" << std::endl;
+        return 1;
+    }
+
+    Simulator streamSim;
+    long long streamTime = timeMs([&](){
+        std::ifstream marketData(argv[1]);
+        streamSim.loadMarketData(marketData);
+    });
+
+    Simulator mappedSim;
+    long long mappedTime = timeMs([&](){
+        MappedFile marketData(argv[1]);
+        mappedSim.loadMarketData(marketData.view());
+    });
+
+    std::cout << "trades:   " << mappedSim.marketHistory.size() << "\n"
+              << "ifstream: " << streamTime << " ms\n"
+              << "mapped:   " << mappedTime << " ms" << std::endl;
+    bool same = streamSim.marketHistory == mappedSim.marketHistory;
+
+    if(argc >= 3){
+        streamTime = timeMs([&](){
+            std::ifstream orderBookData(argv[2]);
+            streamSim.loadOrderBookData(orderBookData);
+        });
+        mappedTime = timeMs([&](){
+            MappedFile orderBookData(argv[2]);
+            mappedSim.loadOrderBookData(orderBookData.view());
+        });
+        std::cout << "books:    " << mappedSim.orderBooks.size() << "\n"
+                  << "ifstream: " << streamTime << " ms\n"
+                  << "mapped:   " << mappedTime << " ms" << std::endl;
+        same = same && streamSim.orderBooks == mappedSim.orderBooks;
+
+        Simulator bothSim;
+        long long bothTime = timeMs([&](){ bothSim.loadHistoricalData(std::string(argv[1]), std::string(argv[2])); });
+        std::cout << "loadHistoricalData: " << bothTime << " ms" << std::endl;
+
+        Simulator buildCacheSim;
+        long long buildTime = timeMs([&](){ buildCacheSim.loadHistoricalData(std::string(argv[1]), std::string(argv[2]), true); });
+        Simulator cachedSim;
+        long long cachedTime = timeMs([&](){ cachedSim.loadHistoricalData(std::string(argv[1]), std::string(argv[2]), true); });
+        std::cout << "loadHistoricalData (cache): " << buildTime << " ms first run, " << cachedTime << " ms cached" << std::endl;
+        same = same && cachedSim.marketHistory == bothSim.marketHistory && cachedSim.orderBooks == bothSim.orderBooks;
+    }
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include "..\PendingOrders.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+// Gives each order its own id, as the simulator would, so byId holds them all.
+struct NumberedLimit : LimitOrder
+{
+    NumberedLimit(int id, ActionType actionType, double quantity, double price) : LimitOrder(actionType, quantity, price){
+        actionId = id;
+    }
+};
+
+template<typename F>
+double timeNs(F f){
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+// Usage: CommonBenchmarks PendingOrdersBenchmark [steps]
+//
+// A grid model with a growing number of resting limit orders, one tick apart
+// around a randomly walking price. Every filled order is replaced by one on
+// the other side, so the number of fills stays the same whatever the grid
+// size. The cost per step of PendingOrders::trigger should follow the fills,
+// while a scan of every resting order grows with the grid.
+int PendingOrdersBenchmark(int argc, char* argv[]){
+    std::size_t steps = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const double tick = 0.1;
+
+    for(int orders : {100, 1000, 10000}){
+        PendingOrders pending;
+        std::vector<LimitOrder> scanned;
+        int nextId = 1;
+        for(int level = 1; level <= orders / 2; level++){
+            pending.insert(NumberedLimit(nextId++, BUY, 1, 1000 - level * tick));
+            pending.insert(NumberedLimit(nextId++, SELL, 1, 1000 + level * tick));
+            scanned.push_back(LimitOrder(BUY, 1, 1000 - level * tick));
+            scanned.push_back(LimitOrder(SELL, 1, 1000 + level * tick));
+        }
+
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> move(-1, 1);
+        std::vector<int> path(steps);
+        int p = 0;
+        for(int &point : path)
+            point = p += move(rng);
+
+        std::size_t fills = 0;
+        std::vector<LimitOrder> replaced;
+        double indexed = timeNs([&](){
+            for(int point : path){
+                double price = 1000 + point * tick;
+                replaced.clear();
+                fills += pending.trigger(price, [&](const Action &order){
+                    const LimitOrder &lo = static_cast<const LimitOrder&>(order);
+                    replaced.push_back(NumberedLimit(nextId++, lo.actionType == BUY ? SELL : BUY, 1, lo.actionType == BUY ? lo.price + tick : lo.price - tick));
+                });
+                for(const LimitOrder &lo : replaced)
+                    pending.insert(lo);
+            }
+        });
+
+        std::size_t scanFills = 0;
+        double scan = timeNs([&](){
+            for(int point : path){
+                double price = 1000 + point * tick;
+                for(LimitOrder &lo : scanned){
+                    if(lo.actionType == BUY ? price <= lo.price : price >= lo.price){
+                        lo = LimitOrder(lo.actionType == BUY ? SELL : BUY, 1, lo.actionType == BUY ? lo.price + tick : lo.price - tick);
+                        scanFills++;
+                    }
+                }
+            }
+        });
+
+        std::cout << orders << " resting orders: " << static_cast<double>(fills) / steps << " fills, "
+                  << "trigger " << indexed / steps << " ns, "
+                  << "scan " << scan / steps << " ns per step"
+                  << (fills == scanFills ? "" : " (fill counts differ)") << std::endl;
+    }
+    return 0;
+}
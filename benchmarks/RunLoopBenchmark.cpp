@@ -0,0 +1,72 @@
+#define Simulator() Simulator(); friend int RunLoopBenchmark(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+class IdleModel : public Model
+{
+public:
+    std::vector<Action *> run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions, 
+               const MarketHistory &market, const OrderBook &orderBook) override {
+        return {};
+    }
+};
+
+template<typename F>
+double timeNs(F f){
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+// Usage: CommonBenchmarks RunLoopBenchmark <aggTrades.csv> <orderBook.csv>
+//
+// Per-event cost of producing timesteps through the mode dispatching
+// TimestepCursor::next and the mode specific TimestepCursor::advance, and of a
+// whole run with a model that never acts.
+int RunLoopBenchmark(int argc, char* argv[]){
+    if(argc < 3){
+        std::cerr << "usage: RunLoopBenchmark <aggTrades.csv> <orderBook.csv>" << std::endl;
+        return 1;
+    }
+
+    IdleModel model; // outlives sim, which hands it its action pool
+    Simulator sim;
+    sim.loadHistoricalData(std::string(argv[1]), std::string(argv[2]));
+
+    auto benchmark = [&]<Simulator::TIMESTEP_MODE Mode>(const char *name){
+        std::size_t events = 0;
+        std::size_t checksum = 0;
+        double dispatched = timeNs([&](){
+            for(Simulator::TimestepCursor cursor(sim, Mode); cursor.next(); events++)
+                checksum += cursor.marketHistoryIndex();
+        });
+        double specialized = timeNs([&](){
+            for(Simulator::TimestepCursor cursor(sim, Mode); cursor.advance<Mode>(); )
+                checksum -= cursor.marketHistoryIndex();
+        });
+
+        sim.portfolioValue.clear();
+        sim.init(&model, Portfolio{1000, 0}, Mode, 0.001, 0.001);
+        double run = timeNs([&](){ sim.run(); });
+
+        std::cout << name << ": " << events << " timesteps, "
+                  << "next " << dispatched / events << " ns, "
+                  << "advance " << specialized / events << " ns, "
+                  << "run " << run / events << " ns per timestep" << std::endl;
+        return checksum == 0;
+    };
+
+    bool ok = benchmark.operator()<Simulator::BOTH>("BOTH");
+    ok = benchmark.operator()<Simulator::ORDER_BOOK>("ORDER_BOOK") && ok;
+    ok = benchmark.operator()<Simulator::MARKET>("MARKET") && ok;
+    return ok ? 0 : 1;
+}
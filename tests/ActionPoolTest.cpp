@@ -0,0 +1,59 @@
+#define Simulator() Simulator(); friend int ActionPoolTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include "TestFixtures.h"
+#include <filesystem>
+
+int ActionPoolTest(int argc, char* argv[]){
+    Simulator sim;
+    IdleModel model;
+
+    // Without a simulator actions come from the heap.
+    LimitOrder *heap = model.make<LimitOrder>(BUY, 1, 100);
+    bool ok = heap->price == 100;
+    sim.release(*heap);
+
+    LimitOrder *first = sim.actionPool.make<LimitOrder>(SELL, 2, 101);
+    Cancel *cancel = sim.actionPool.make<Cancel>(7);
+    ok = ok && first->quantity == 2 && cancel->orderId == 7
+        && first->index() == Action::typeIndex<LimitOrder>() && cancel->index() == Action::typeIndex<Cancel>();
+
+    // A released slot is handed out again.
+    void *slot = first;
+    sim.release(*first);
+    MarketOrder *reused = sim.actionPool.make<MarketOrder>(BUY, 3);
+    ok = ok && static_cast<void*>(reused) == slot && reused->quantity == 3;
+    sim.release(*reused);
+
+    // Actions returned by pointer are copied into values and their slot freed.
+    ActionValue value = sim.takeAction(cancel);
+    ok = ok && std::holds_alternative<Cancel>(value) && std::get<Cancel>(value).orderId == 7
+        && static_cast<void*>(sim.actionPool.make<Cancel>(8)) == static_cast<void*>(cancel);
+
+    // A model makes its actions in the pool of the simulator running it, and
+    // on the heap again once that simulator is gone.
+    {
+        Simulator running;
+        running.logDirectory = (std::filesystem::temp_directory_path() / "revival-logs" / "").string();
+        running.init(&model);
+        LimitOrder *pooled = model.make<LimitOrder>(BUY, 1, 100);
+        running.release(*pooled);
+        ok = ok && static_cast<void*>(running.actionPool.make<LimitOrder>(BUY, 1, 100)) == static_cast<void*>(pooled);
+    }
+    LimitOrder *after = model.make<LimitOrder>(BUY, 1, 100);
+    ok = ok && after->price == 100;
+    sim.release(*after);
+
+    // Without a model there is nothing to hand the pool to.
+    bool rejected = false;
+    try{
+        sim.init(nullptr);
+    }catch(const std::invalid_argument&){
+        rejected = true;
+    }
+    ok = ok && rejected && !sim.model;
+    return ok ? 0 : 1;
+}
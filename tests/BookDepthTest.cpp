@@ -0,0 +1,41 @@
+#include "..\BookDepth.h"
+
+#include "TestFixtures.h"
+
+int BookDepthTest(int argc, char* argv[]){
+    // Best levels at the back, as MarketDataParser leaves them.
+    std::vector<Order> bids{{97, 3}, {98, 2}, {99, 1}};
+    std::vector<Order> asks{{103, 3}, {102, 2}, {101, 1}};
+
+    BookDepth depth;
+    bool ok = !depth.holds(5, TimePoint(10));
+    depth.assign(5, TimePoint(10), bids, asks);
+    ok = ok && depth.holds(5, TimePoint(10)) && !depth.holds(6, TimePoint(10)) && depth.hasAsks() && depth.hasBids();
+
+    // Within the best level.
+    BookDepth::Fill fill = depth.buy(0.5);
+    ok = ok && near(fill.quantity, 0.5) && near(fill.notional, 50.5) && near(fill.price, 101);
+
+    // Across two levels: 1 at 101 and 1.5 at 102.
+    fill = depth.buy(2.5);
+    ok = ok && near(fill.quantity, 2.5) && near(fill.notional, 101 + 153) && near(fill.price, 254 / 2.5);
+
+    // More than the book holds fills what there is.
+    fill = depth.sell(10);
+    ok = ok && near(fill.quantity, 6) && near(fill.notional, 99 + 196 + 291);
+
+    // 305 buys 1 at 101 and 2 at 102, and 0 at 103.
+    fill = depth.buyFor(305);
+    ok = ok && near(fill.quantity, 3) && near(fill.notional, 305);
+    fill = depth.buyFor(305 + 51.5);
+    ok = ok && near(fill.quantity, 3.5) && near(fill.notional, 356.5);
+
+    fill = depth.sell(0);
+    ok = ok && fill.quantity == 0 && fill.price == 99;
+
+    depth.assign(6, TimePoint(11), std::vector<Order>(), asks);
+    ok = ok && !depth.hasBids() && depth.hasAsks();
+    depth.clear();
+    ok = ok && !depth.holds(6, TimePoint(11));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#define Simulator() Simulator(); friend int CompressedFileTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include "..\MarketDataStream.h"
+#include "TestFixtures.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Two trades, gzip compressed.
+const unsigned char trades[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x33, 0xd4, 0x31, 0x34, 0x30, 0xd0,
+    0x31, 0x84, 0x40, 0x73, 0x53, 0x43, 0x13, 0x43, 0x13, 0x13, 0x03, 0x28, 0xd0, 0x29, 0x29, 0x2a,
+    0x4d, 0x05, 0x13, 0x5c, 0x46, 0x40, 0x65, 0x86, 0x3a, 0x46, 0x60, 0x08, 0x57, 0x66, 0x88, 0xa1,
+    0x0c, 0x00, 0xed, 0x27, 0x6c, 0x4b, 0x4e, 0x00, 0x00, 0x00
+};
+
+void write(const std::filesystem::path &path, const unsigned char *data, std::size_t size){
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+}
+
+int CompressedFileTest(int argc, char* argv[]){
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "revival-compressed";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::ofstream(dir / "books.csv") << "10,1751414400500,\"[[101, 1]]\",\"[[100, 1]]\"\n";
+
+    write(dir / "trades.csv.gz", trades, sizeof(trades));
+    write(dir / "truncated.csv.gz", trades, sizeof(trades) - 12);
+    unsigned char corrupt[sizeof(trades)];
+    std::copy(std::begin(trades), std::end(trades), corrupt);
+    corrupt[sizeof(trades) - 6] ^= 0xff; // in the CRC
+    write(dir / "corrupt.csv.gz", corrupt, sizeof(corrupt));
+
+    // A damaged file loads as nothing rather than as part of its rows.
+    auto loadedTrades = [](const std::filesystem::path &tradesFile, const std::filesystem::path &booksFile){
+        Simulator sim;
+        sim.loadHistoricalData(tradesFile.string(), booksFile.string());
+        return sim.marketHistory.size();
+    };
+    bool ok = loadedTrades(dir / "trades.csv.gz", dir / "books.csv") == 2;
+    ok = ok && loadedTrades(dir / "truncated.csv.gz", dir / "books.csv") == 0;
+    ok = ok && loadedTrades(dir / "corrupt.csv.gz", dir / "books.csv") == 0;
+
+    // A directory holds plain and compressed data files, but its caches and
+    // other files are left alone.
+    std::filesystem::create_directories(dir / "day");
+    write(dir / "day" / "a.csv.gz", trades, sizeof(trades));
+    std::ofstream(dir / "day" / "b.csv") << "3,102,1,3,3,1751414402000000,true,true\n";
+    std::ofstream(dir / "day" / "b.csv.rvcache") << "not a cache\n";
+    std::ofstream(dir / "day" / "notes.txt") << "not a data file\n";
+    ok = ok && loadedTrades(dir / "day", dir / "books.csv") == 3;
+
+    for(const char *file : {"trades.csv.gz", "truncated.csv.gz"}){
+        MarketDataStream stream((dir / file).string(), (dir / "books.csv").string(), 16);
+        std::size_t streamed = 0;
+        for(; stream.peekTrade(); stream.popTrade())
+            streamed++;
+        bool damaged = file != std::string("trades.csv.gz");
+        ok = ok && stream.hasFailed() == damaged && streamed == (damaged ? 0 : 2);
+    }
+
+    // A streamed run that stops at the damage is an error, not a shorter run.
+    for(const char *file : {"trades.csv.gz", "truncated.csv.gz"}){
+        IdleModel model;
+        Simulator sim;
+        sim.logDirectory = (std::filesystem::temp_directory_path() / "revival-logs" / "").string();
+        sim.streamHistoricalData((dir / file).string(), (dir / "books.csv").string(), 16);
+        sim.init(&model, Portfolio{1000, 0}, Simulator::MARKET);
+        bool failed = false;
+        try{
+            sim.run();
+        }catch(const std::runtime_error &){
+            failed = true;
+        }
+        ok = ok && failed == (file != std::string("trades.csv.gz"));
+    }
+
+    std::filesystem::remove_all(dir);
+    return ok ? 0 : 1;
+}
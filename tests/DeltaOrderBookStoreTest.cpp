@@ -0,0 +1,43 @@
+#include "..\DeltaOrderBookStore.h"
+
+#include <random>
+
+int DeltaOrderBookStoreTest(int argc, char* argv[]){
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> move(-2, 2);
+    std::uniform_int_distribution<int> size(1, 50);
+    std::uniform_int_distribution<int> depth(0, 20);
+
+    std::vector<OrderBook> orderBooks;
+    int mid = 100000;
+    for(int i = 0; i < 300; i++){
+        mid += move(rng);
+        OrderBook orderBook{i, TimePoint(i * 100)};
+        int bidDepth = depth(rng), askDepth = depth(rng);
+        for(int level = bidDepth; level > 0; level--)
+            orderBook.bids.push_back(Order{(mid - level) / 10.0, size(rng) / 10.0});
+        for(int level = askDepth; level > 0; level--)
+            orderBook.asks.push_back(Order{(mid + level) / 10.0, size(rng) / 10.0});
+        orderBooks.push_back(orderBook);
+    }
+
+    DeltaOrderBookStore store;
+    for(const auto& orderBook : orderBooks)
+        store.append(orderBook);
+    store.shrinkToFit();
+
+    if(store.size() != orderBooks.size())
+        return 1;
+    for(std::size_t i = 0; i < orderBooks.size(); i++)
+        if(store.at(i) != orderBooks[i])
+            return 1;
+
+    // Backwards and across keyframes.
+    std::uniform_int_distribution<std::size_t> index(0, orderBooks.size() - 1);
+    for(int i = 0; i < 200; i++){
+        std::size_t j = index(rng);
+        if(store.at(j) != orderBooks[j])
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#define Simulator() Simulator(); friend int FlatOrderBooksTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include "..\DeltaOrderBookStore.h"
+#include "..\OrderBookArena.h"
+#include <filesystem>
+#include <fstream>
+
+int FlatOrderBooksTest(int argc, char* argv[]){
+    // Parsed rows and appended books read back the same, best level at back().
+    OrderBookArena arena;
+    arena.parse("lastUpdateId,E,asks,bids\n"
+                "2,20,\"[[\"\"101\"\", \"\"1\"\"], [\"\"102\"\", \"\"2\"\"]]\",\"[[\"\"100\"\", \"\"3\"\"], [\"\"99\"\", \"\"4\"\"]]\"\n"
+                "3,10,\"[]\",\"[[\"\"98\"\", \"\"5\"\"]]\"\n");
+    OrderBookArena appended;
+    appended.append(OrderBook{1, TimePoint(5), {{97, 6}}, {{104, 7}, {103, 8}}});
+    arena.append(std::move(appended));
+    OrderBookView first = arena.view(0);
+    bool ok = arena.size() == 3 && appended.empty()
+        && first.lastUpdateId == 2 && first.E == TimePoint(20)
+        && first.asks.size() == 2 && first.asks.front() == Order{102, 2} && first.asks.back() == Order{101, 1}
+        && first.bids.size() == 2 && first.bids.front() == Order{99, 4} && first.bids.back() == Order{100, 3};
+    ok = ok && arena.view(1).asks.empty() && arena.view(1).bids.size() == 1
+        && arena.orderBook(2) == OrderBook{1, TimePoint(5), {{97, 6}}, {{104, 7}, {103, 8}}};
+    arena.sortByTime(0);
+    ok = ok && arena.view(0).lastUpdateId == 1 && arena.view(1).lastUpdateId == 3 && arena.view(2).lastUpdateId == 2
+        && arena.view(2).bids.back() == Order{100, 3};
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "revival-flat";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    // Overlapping in time, so the merged books have to be re-sorted.
+    std::ofstream(dir / "books-a.csv") << "lastUpdateId,E,asks,bids\n"
+        << "10,1000,\"[[101, 1], [102, 2]]\",\"[[100, 1], [99, 2]]\"\n"
+        << "30,3000,\"[[103, 1]]\",\"[[98, 3], [100, 1]]\"\n";
+    std::ofstream(dir / "books-b.csv")
+        << "20,2000,\"[[105, 1], [104, 2], [106, 3]]\",\"[]\"\n"
+        << "40,4000,\"[[101, 4]]\",\"[[100, 4]]\"\n";
+    std::ofstream(dir / "trades.csv") << "1,100,1,1,1,1000000,true,true\n";
+    std::vector<std::string> books{(dir / "books-a.csv").string(), (dir / "books-b.csv").string()};
+    std::vector<std::string> trades{(dir / "trades.csv").string()};
+
+    Simulator full;
+    full.loadHistoricalData(trades, books);
+    ok = ok && full.orderBooks.size() == 4;
+
+    // Books loaded while FLAT is set, without the cache, writing it and
+    // reading it, hold their levels in the arena only.
+    for(int pass = 0; pass < 3; pass++){
+        Simulator flat;
+        flat.setOrderBookStorage(Simulator::FLAT);
+        flat.loadHistoricalData(trades, books, pass > 0);
+        ok = ok && flat.orderBooks.size() == 4 && flat.flatOrderBooks->size() == 4;
+        for(std::size_t i = 0; ok && i < flat.orderBooks.size(); i++){
+            const OrderBook &orderBook = flat.orderBooks[i];
+            ok = orderBook.lastUpdateId == full.orderBooks[i].lastUpdateId && orderBook.E == full.orderBooks[i].E
+                && orderBook.bids.empty() && orderBook.asks.empty()
+                && flat.flatOrderBooks->orderBook(i) == full.orderBooks[i];
+        }
+        ok = ok && std::filesystem::exists(dir / "books-a.csv.rvcache") == (pass > 0);
+    }
+
+    // Switching after loading converts what is there, and back again.
+    Simulator converted;
+    converted.loadHistoricalData(trades, books);
+    converted.setOrderBookStorage(Simulator::FLAT);
+    for(std::size_t i = 0; ok && i < converted.orderBooks.size(); i++)
+        ok = converted.orderBooks[i].bids.empty() && converted.flatOrderBooks->orderBook(i) == full.orderBooks[i];
+    converted.setOrderBookStorage(Simulator::FULL);
+    ok = ok && !converted.flatOrderBooks && converted.orderBooks == full.orderBooks;
+
+    // DELTA set before loading stores the books as they arrive as well.
+    Simulator delta;
+    delta.setOrderBookStorage(Simulator::DELTA);
+    delta.loadHistoricalData(trades, books);
+    for(std::size_t i = 0; ok && i < delta.orderBooks.size(); i++)
+        ok = delta.orderBooks[i].bids.empty() && delta.deltaOrderBooks->at(i) == full.orderBooks[i];
+
+    std::filesystem::remove_all(dir);
+    return ok ? 0 : 1;
+}
@@ -19,11 +19,7 @@ int GetBothTimestepsTest(int argc, char* argv[]){
         Trade{0, 4, 4, TimePoint(12)}
     };
 
-    sim.marketHistory.insert(
-        sim.marketHistory.end(), 
-        trades, 
-        trades+sizeof(trades)/sizeof(Trade)
-    );
+    sim.marketHistory.assign(trades);
 
     OrderBook orderBooks[]{
         OrderBook{0, TimePoint(6)},
@@ -40,32 +36,32 @@ int GetBothTimestepsTest(int argc, char* argv[]){
     std::vector<Simulator::Timestep> expectedts{
         Simulator::Timestep(
             trades[0].timestamp, 
-            std::span(sim.marketHistory).subspan(0, 1),
+            TradeView(sim.marketHistory).first(1),
             Simulator::initialOrderBook
         ),
         Simulator::Timestep(
             orderBooks[0].E, 
-            std::span(sim.marketHistory).subspan(0, 1),
+            TradeView(sim.marketHistory).first(1),
             orderBooks[0]
         ),
         Simulator::Timestep(
             trades[1].timestamp, 
-            std::span(sim.marketHistory).subspan(0, 2),
+            TradeView(sim.marketHistory).first(2),
             orderBooks[0]
         ),
         Simulator::Timestep(
             orderBooks[1].E, 
-            std::span(sim.marketHistory).subspan(0, 2),
+            TradeView(sim.marketHistory).first(2),
             orderBooks[1]
         ),
         Simulator::Timestep(
             trades[2].timestamp, 
-            std::span(sim.marketHistory).subspan(0, 3),
+            TradeView(sim.marketHistory).first(3),
             orderBooks[1]
         ),
         Simulator::Timestep(
             trades[3].timestamp, 
-            std::span(sim.marketHistory).subspan(0, 4),
+            TradeView(sim.marketHistory).first(4),
             orderBooks[1]
         ),
     };
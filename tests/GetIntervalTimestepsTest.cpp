@@ -0,0 +1,52 @@
+#define Simulator() Simulator(); friend int GetIntervalTimestepsTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include <stdexcept>
+
+int GetIntervalTimestepsTest(int argc, char* argv[]){
+    Simulator sim;
+    sim.tsInterval = TimePoint(5);
+
+    sim.marketHistory = {
+        Trade{0, 1, 1, TimePoint(4)},
+        Trade{0, 2, 2, TimePoint(8)},
+        Trade{0, 3, 3, TimePoint(11)},
+        Trade{0, 4, 4, TimePoint(12)},
+        Trade{0, 5, 5, TimePoint(31)}
+    };
+    sim.orderBooks = {
+        OrderBook{0, TimePoint(6)},
+        OrderBook{0, TimePoint(9)},
+        OrderBook{0, TimePoint(20)}
+    };
+
+    std::vector<Simulator::Timestep> ts = sim.getTimesteps(Simulator::INTERVAL);
+
+    // [25, 30) holds no event and is skipped.
+    std::vector<Simulator::Timestep> expectedts{
+        Simulator::Timestep(TimePoint(5), TradeView(sim.marketHistory).first(1), Simulator::initialOrderBook),
+        Simulator::Timestep(TimePoint(10), TradeView(sim.marketHistory).first(2), sim.orderBooks[1]),
+        Simulator::Timestep(TimePoint(15), TradeView(sim.marketHistory).first(4), sim.orderBooks[1]),
+        Simulator::Timestep(TimePoint(25), TradeView(sim.marketHistory).first(4), sim.orderBooks[2]),
+        Simulator::Timestep(TimePoint(35), TradeView(sim.marketHistory).first(5), sim.orderBooks[2])
+    };
+
+    bool ok = ts == expectedts;
+    for(std::size_t i = 0; ok && i < ts.size(); i++)
+        ok = &std::get<2>(ts[i]) == &std::get<2>(expectedts[i]);
+
+    // An interval that is not positive is rejected before anything changes.
+    for(TimePoint interval : {TimePoint(0), TimePoint(-5)}){
+        bool rejected = false;
+        try{
+            sim.init(nullptr, Portfolio{1000, 0}, Simulator::INTERVAL, 0, 0, interval);
+        }catch(const std::invalid_argument&){
+            rejected = true;
+        }
+        ok = ok && rejected && sim.tsInterval == TimePoint(5);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#define Simulator() Simulator(); friend int GetMarketTimestepsTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+#include <QApplication>
+
+#undef Simulator
+
+int GetMarketTimestepsTest(int argc, char* argv[]){
+    QApplication a(argc, argv);
+    Simulator sim;
+
+    Trade trades[]{
+        Trade{0, 1, 1, TimePoint(4)},
+        Trade{0, 2, 2, TimePoint(10)},
+        Trade{0, 3, 3, TimePoint(12)}
+    };
+
+    sim.marketHistory.assign(trades);
+
+    // A book is seen from the trade at its own time on, as it is when
+    // earlier books are skipped on the way to it.
+    OrderBook orderBooks[]{
+        OrderBook{0, TimePoint(10)},
+        OrderBook{0, TimePoint(13)}
+    };
+
+    sim.orderBooks.insert(sim.orderBooks.end(), 
+        orderBooks,
+        orderBooks+sizeof(orderBooks)/sizeof(OrderBook)
+    );
+
+    std::vector<Simulator::Timestep> ts = sim.getMarketTimesteps();
+
+    std::vector<Simulator::Timestep> expectedts{
+        Simulator::Timestep(
+            TimePoint(5), 
+            TradeView(sim.marketHistory).first(1),
+            Simulator::initialOrderBook
+        ),
+        Simulator::Timestep(
+            TimePoint(11), 
+            TradeView(sim.marketHistory).first(2),
+            orderBooks[0]
+        ),
+        Simulator::Timestep(
+            TimePoint(13), 
+            TradeView(sim.marketHistory).first(3),
+            orderBooks[0]
+        ),
+    };
+
+    return ts == expectedts ? 0 : 1;
+}
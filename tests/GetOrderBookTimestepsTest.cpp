@@ -16,11 +16,7 @@ int GetOrderBookTimestepsTest(int argc, char* argv[]){
         Trade{0, 4, 4, TimePoint(12)}
     };
 
-    sim.marketHistory.insert(
-        sim.marketHistory.end(), 
-        trades, 
-        trades+sizeof(trades)/sizeof(Trade)
-    );
+    sim.marketHistory.assign(trades);
 
     OrderBook orderBooks[]{
         OrderBook{0, TimePoint(6)},
@@ -37,12 +33,12 @@ int GetOrderBookTimestepsTest(int argc, char* argv[]){
     std::vector<Simulator::Timestep> expectedts{
         Simulator::Timestep(
             orderBooks[0].E, 
-            std::span(sim.marketHistory).subspan(0, 1),
+            TradeView(sim.marketHistory).first(1),
             orderBooks[0]
         ),
         Simulator::Timestep(
             orderBooks[1].E, 
-            std::span(sim.marketHistory).subspan(0, 2),
+            TradeView(sim.marketHistory).first(2),
             orderBooks[1]
         ),
     };
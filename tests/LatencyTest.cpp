@@ -0,0 +1,44 @@
+#define Simulator() Simulator(); friend int LatencyTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+int LatencyTest(int argc, char* argv[]){
+    Simulator sim;
+    OrderBook orderBook{1, TimePoint(100)};
+    TradeColumns trades{Trade{1, 100, 1, TimePoint(100)}};
+
+    // Orders take 30ms, cancels 10ms, and market data adds 5ms to both.
+    sim.setLatency({TimePoint(30)}, {TimePoint(10)}, {TimePoint(5)});
+    Simulator::Timestep ts(TimePoint(100), MarketHistory{trades}, orderBook);
+    ActionValue order = LimitOrder(BUY, 1, 99);
+    ActionValue cancel = Cancel(7);
+    ActionValue later = MarketOrder(SELL, 1);
+    sim.dispatch(ts, order);
+    sim.dispatch(ts, cancel);
+    sim.dispatch(ts, later);
+
+    std::vector<std::pair<TimePoint, std::size_t>> arrivals;
+    while(!sim.inFlight.empty()){
+        std::pop_heap(sim.inFlight.begin(), sim.inFlight.end(), Simulator::InFlight::arrivesAfter);
+        arrivals.emplace_back(sim.inFlight.back().arrival, sim.inFlight.back().action.index());
+        sim.inFlight.pop_back();
+    }
+    bool ok = arrivals == std::vector<std::pair<TimePoint, std::size_t>>{
+        {TimePoint(115), 3}, {TimePoint(135), 1}, {TimePoint(135), 0}};
+
+    // Jitter only adds to the fixed part and is the same for the same seed.
+    Simulator::Latency jittered{TimePoint(20), TimePoint(5)};
+    sim.setLatency(jittered, jittered, Simulator::Latency{}, 3);
+    sim.latencyRng.seed(sim.latencySeed);
+    std::vector<TimePoint> first, second;
+    for(int i = 0; i < 100; i++)
+        first.push_back(sim.sampleLatency(jittered));
+    sim.latencyRng.seed(sim.latencySeed);
+    for(int i = 0; i < 100; i++)
+        second.push_back(sim.sampleLatency(jittered));
+    ok = ok && first == second && std::ranges::all_of(first, [](TimePoint t){ return t >= TimePoint(20); })
+        && std::ranges::any_of(first, [](TimePoint t){ return t > TimePoint(20); });
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+#define Simulator() Simulator(); friend int MarketDataCacheTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+#include "..\MarketDataCache.h"
+
+#undef Simulator
+
+#include <filesystem>
+#include <fstream>
+
+int MarketDataCacheTest(int argc, char* argv[]){
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+    std::string marketFile = (dir / "revival-cache-trades.csv").string();
+    std::string orderBookFile = (dir / "revival-cache-books.csv").string();
+    std::filesystem::remove(MarketDataCache::cachePath(marketFile));
+    std::filesystem::remove(MarketDataCache::cachePath(orderBookFile));
+
+    std::ofstream(marketFile) 
+        << "1,100.5,0.25,1,1,1751414400000000,true,true\n"
+        << "2,100.75,1.5,2,3,1751414400004000,false,true\n";
+    std::ofstream(orderBookFile) 
+        << "10,1751414400001,\"[[101, 1],[102, 2]]\",\"[[100, 3]]\"\n"
+        << "11,1751414400101,\"[]\",\"[[99.5, 4],[99, 0.5]]\"\n";
+
+    Simulator parsed;
+    parsed.loadHistoricalData(marketFile, orderBookFile, true);
+    if(!std::filesystem::exists(MarketDataCache::cachePath(marketFile)) ||
+       !std::filesystem::exists(MarketDataCache::cachePath(orderBookFile)))
+        return 1;
+
+    Simulator cached;
+    cached.loadHistoricalData(marketFile, orderBookFile, true);
+    if(parsed.marketHistory != cached.marketHistory || parsed.orderBooks != cached.orderBooks)
+        return 1;
+    if(cached.marketHistory.size() != 2 || cached.orderBooks.size() != 2)
+        return 1;
+    if(!cached.marketHistory[0].isBuyerMaker || cached.marketHistory[1].isBuyerMaker)
+        return 1;
+
+    // Level counts that do not add up to the stored levels reject the cache.
+    {
+        std::fstream cache(MarketDataCache::cachePath(orderBookFile), std::ios::in | std::ios::out | std::ios::binary);
+        cache.seekp(sizeof(MarketDataCache::CacheHeader) + 2 * 2 * sizeof(std::uint64_t));
+        std::uint64_t bidCount = 1000;
+        cache.write(reinterpret_cast<const char*>(&bidCount), sizeof(bidCount));
+    }
+    Simulator rejected;
+    rejected.loadHistoricalData(marketFile, orderBookFile, true);
+    if(rejected.orderBooks != parsed.orderBooks)
+        return 1;
+
+    // Growing the source makes its cache stale.
+    std::ofstream(marketFile, std::ios::app) << "3,101,2,4,4,1751414400009000,true,true\n";
+    Simulator reparsed;
+    reparsed.loadHistoricalData(marketFile, orderBookFile, true);
+    return reparsed.marketHistory.size() == 3 && reparsed.orderBooks == parsed.orderBooks ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#define Simulator() Simulator(); friend int MarketHistoryWindowTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+int MarketHistoryWindowTest(int argc, char* argv[]){
+    Simulator sim;
+    for(int i = 0; i < 10; i++)
+        sim.marketHistory.push_back(Trade{i, 100.0 + i, 1, TimePoint(10 * (i / 2))});
+    MarketHistory full{TradeView(sim.marketHistory)};
+
+    // 0, 0, 10, 10, 20, 20, ...
+    bool ok = full.lowerBound(TimePoint(10)) == 2 && full.upperBound(TimePoint(10)) == 4
+        && full.lowerBound(TimePoint(5)) == 2 && full.lowerBound(TimePoint(100)) == 10
+        && full.since(TimePoint(40)).size() == 2;
+
+    // Model last called after 6 trades, 10 now, looking back 2 more.
+    sim.lastRunTradeEnd = 6;
+    sim.historyBase = 0;
+    sim.setMarketHistoryLookback(2);
+    MarketHistory window = sim.marketWindow(full);
+    ok = ok && window.trades.size() == 6 && window.trades.front().tradeId == 4 
+        && window.newTrades == 4 && window.sinceLastCall().front().tradeId == 6
+        && window.prices().front() == 104 && window.lowerBound(TimePoint(30)) == 2;
+
+    // Streamed: the first 5 trades were already dropped from the window.
+    sim.historyBase = 5;
+    MarketHistory streamed{TradeView(sim.marketHistory).subspan(5), 5};
+    window = sim.marketWindow(streamed);
+    ok = ok && window.trades.size() == 5 && window.trades.front().tradeId == 5 && window.newTrades == 4;
+
+    sim.setMarketHistoryLookback(std::numeric_limits<std::size_t>::max());
+    sim.historyBase = 0;
+    window = sim.marketWindow(full);
+    ok = ok && window.trades.size() == 10 && window.newTrades == 4;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#define Simulator() Simulator(); friend int MultiFileLoadTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include <filesystem>
+#include <fstream>
+
+int MultiFileLoadTest(int argc, char* argv[]){
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "revival-multifile";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "trades");
+
+    // Named so that directory order differs from time order.
+    std::ofstream(dir / "trades" / "b-day2.csv") 
+        << "3,102,1,3,3,1751500800000000,true,true\n"
+        << "4,103,1,4,4,1751500801000000,true,true\n";
+    std::ofstream(dir / "trades" / "a-day1.csv") 
+        << "1,100,1,1,1,1751414400000000,true,true\n"
+        << "2,101,1,2,2,1751414401000000,true,true\n";
+    std::ofstream(dir / "trades" / "notes.txt") << "not a data file\n";
+    std::ofstream(dir / "books-day2.csv") << "20,1751500800500,\"[[103, 1]]\",\"[[102, 1]]\"\n";
+    std::ofstream(dir / "books-day1.csv") << "10,1751414400500,\"[[101, 1]]\",\"[[100, 1]]\"\n";
+
+    Simulator sim;
+    sim.loadHistoricalData(
+        std::vector<std::string>{(dir / "trades").string()}, 
+        std::vector<std::string>{(dir / "books-day2.csv").string(), (dir / "books-day1.csv").string()});
+
+    bool ok = sim.marketHistory.size() == 4 && sim.orderBooks.size() == 2;
+    for(std::size_t i = 0; ok && i < sim.marketHistory.size(); i++)
+        ok = sim.marketHistory[i].tradeId == static_cast<long long>(i + 1);
+    ok = ok && sim.orderBooks[0].lastUpdateId == 10 && sim.orderBooks[1].lastUpdateId == 20;
+
+    // The first load with the cache writes one per file, the second reads them.
+    for(int pass = 0; pass < 2; pass++){
+        Simulator cachedSim;
+        cachedSim.loadHistoricalData(
+            std::vector<std::string>{(dir / "trades").string()}, 
+            std::vector<std::string>{(dir / "books-day2.csv").string(), (dir / "books-day1.csv").string()}, true);
+        ok = ok && std::filesystem::exists(dir / "trades" / "a-day1.csv.rvcache")
+            && std::filesystem::exists(dir / "books-day1.csv.rvcache");
+        ok = ok && cachedSim.marketHistory.size() == 4 && cachedSim.orderBooks.size() == 2
+            && cachedSim.marketHistory.front().tradeId == 1 && cachedSim.marketHistory.back().tradeId == 4
+            && cachedSim.orderBooks[0].lastUpdateId == 10 && cachedSim.orderBooks[1].lastUpdateId == 20;
+    }
+
+    std::filesystem::remove_all(dir);
+    return ok ? 0 : 1;
+}
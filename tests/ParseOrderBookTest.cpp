@@ -0,0 +1,38 @@
+#include "..\MarketDataParser.h"
+
+#include <string>
+
+static bool parses(const std::string &row, const OrderBook &expected){
+    OrderBook orderBook;
+    const char *end = row.data() + row.size();
+    return MarketDataParser::parseOrderBook(row.data(), end, orderBook) == end && orderBook == expected;
+}
+
+int ParseOrderBookTest(int argc, char* argv[]){
+    bool ok = true;
+
+    ok = ok && parses(
+        "7,1751414400100,\"[[105001.1, 0.5],[105001.2, 0.25]]\",\"[[105000.9, 2],[105000.8, 1.5]]\"\n",
+        OrderBook{7, TimePoint(1751414400100), {{105000.9, 2}, {105000.8, 1.5}}, {{105001.1, 0.5}, {105001.2, 0.25}}});
+
+    ok = ok && parses(
+        "8,9,\"[[\"\"1.5\"\",\"\"2\"\"],[\"\"1.75\"\",\"\"3\"\"]]\",\"[]\"\n",
+        OrderBook{8, TimePoint(9), {}, {{1.5, 2}, {1.75, 3}}});
+
+    ok = ok && parses("9,10,\"[]\",\"[ ]\"", OrderBook{9, TimePoint(10), {}, {}});
+
+    // Shift the closing "]]" across every position of a 16-byte block.
+    for(int padding = 0; padding < 40; padding++){
+        std::string zeros(padding, '0');
+        std::string levels;
+        std::vector<Order> expected;
+        for(int i = 1; i <= 3 + padding % 5; i++){
+            std::string price = std::to_string(i) + "." + zeros + "5";
+            levels += (levels.empty() ? "[" : ",[") + price + ", " + std::to_string(i) + "]";
+            expected.push_back(Order{std::stod(price), static_cast<double>(i)});
+        }
+        ok = ok && parses("1,2,\"[" + levels + "]\",\"[" + levels + "]\"\n", OrderBook{1, TimePoint(2), expected, expected});
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+#define Simulator() Simulator(); friend int PartialFillTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include "TestFixtures.h"
+#include <filesystem>
+
+int PartialFillTest(int argc, char* argv[]){
+    IdleModel model;
+    Simulator sim;
+    sim.logDirectory = (std::filesystem::temp_directory_path() / "revival-logs" / "").string();
+    sim.init(&model, Portfolio{1000, 0, 10, 0}, Simulator::ORDER_BOOK, 0, 0);
+    sim.setLimitFillModel(Simulator::QUEUE_POSITION);
+    sim.tradePrice = 100;
+
+    OrderBook orderBook{1, TimePoint(1)};
+    TradeColumns noTrades;
+    Simulator::Timestep ts(TimePoint(1), MarketHistory{noTrades}, orderBook);
+    auto process = [&](ActionValue action){ sim.processAction(ts, action); };
+    auto holds = [&](double authMoney, double pendingMoney, double authQuantity, double pendingQuantity){
+        return near(sim.portfolio.authMoney, authMoney) && near(sim.portfolio.pendingMoney, pendingMoney)
+            && near(sim.portfolio.authQuantity, authQuantity) && near(sim.portfolio.pendingQuantity, pendingQuantity);
+    };
+
+    int buyId = Simulator::nextActionId;
+    process(LimitOrder(BUY, 4, 95));
+    int sellId = Simulator::nextActionId;
+    process(LimitOrder(SELL, 2, 105));
+    bool ok = holds(620, 380, 8, 2);
+
+    // Each order is filled in part, and only that part leaves pending.
+    TradeColumns trades{Trade{1, 95, 1, TimePoint(2), true}, Trade{2, 105, 0.5, TimePoint(2)}};
+    sim.processQueuedLimits(Simulator::Timestep(TimePoint(2), MarketHistory{trades}, orderBook));
+    ok = ok && holds(620 + 52.5, 380 - 95, 9, 1.5);
+
+    // Amending sets aside what the rest of the order needs at its new price.
+    process(Amend(buyId, 6, 95));
+    ok = ok && holds(482.5, 475, 9, 1.5);
+    process(Amend(buyId, 3, 90));
+    ok = ok && holds(777.5, 180, 9, 1.5);
+    process(Amend(sellId, 4, 105));
+    ok = ok && holds(777.5, 180, 7, 3.5);
+
+    // More than the portfolio can cover, or no more than was filled, is an error.
+    process(Amend(buyId, 100, 90));
+    process(Amend(buyId, 1, 90));
+    process(Amend(sellId, 20, 105));
+    ok = ok && holds(777.5, 180, 7, 3.5);
+
+    // Cancelling gives back only what was not filled.
+    process(Cancel(buyId));
+    process(Cancel(sellId));
+    ok = ok && holds(1000 - 95 + 52.5, 0, 10 + 1 - 0.5, 0) && sim.pendingOrders.empty();
+    return ok ? 0 : 1;
+}
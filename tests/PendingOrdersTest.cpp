@@ -0,0 +1,65 @@
+#include "..\PendingOrders.h"
+
+#include <variant>
+
+namespace {
+
+template<typename T>
+struct Numbered : T
+{
+    Numbered(int id, ActionType actionType, double quantity, double price) : T(actionType, quantity, price){
+        this->actionId = id;
+    }
+};
+
+}
+
+int PendingOrdersTest(int argc, char* argv[]){
+    PendingOrders pending;
+    pending.insert(Numbered<LimitOrder>(1, BUY, 1, 95));
+    pending.insert(Numbered<LimitOrder>(2, BUY, 1, 99));
+    pending.insert(Numbered<LimitOrder>(3, SELL, 1, 101));
+    pending.insert(Numbered<LimitOrder>(4, SELL, 1, 105));
+    pending.insert(Numbered<StopOrder>(5, BUY, 1, 102));
+    pending.insert(Numbered<StopOrder>(6, SELL, 1, 98));
+    pending.insert(Numbered<StopOrder>(7, SELL, 1, 90));
+
+    std::vector<const Action*> resting;
+    pending.collect(resting);
+    bool ok = resting.size() == 7;
+    for(std::size_t i = 0; ok && i < resting.size(); i++)
+        ok = resting[i]->getId() == static_cast<int>(i) + 1;
+
+    // At 98 only the buy limit at 99 and the sell stop at 98 are reached.
+    std::vector<int> filled;
+    auto fill = [&](const Action &order){ filled.push_back(order.getId()); };
+    ok = ok && pending.trigger(98, fill) == 2 && filled == std::vector<int>{2, 6} && pending.size() == 5;
+    ok = ok && !pending.erase(2) && !pending.erase(6);
+
+    filled.clear();
+    ok = ok && pending.trigger(100, fill) == 0 && filled.empty();
+
+    // At 103 the sell limit at 101 and the buy stop at 102 are reached.
+    ok = ok && pending.trigger(103, fill) == 2 && filled == std::vector<int>{3, 5};
+
+    std::optional<ActionValue> cancelled = pending.erase(7);
+    ok = ok && cancelled && std::holds_alternative<StopOrder>(*cancelled)
+        && std::get<StopOrder>(*cancelled).price == 90
+        && !pending.erase(7) && pending.size() == 2;
+
+    resting.clear();
+    pending.collect(resting);
+    ok = ok && resting.size() == 2 && resting[0]->getId() == 1 && resting[1]->getId() == 4;
+
+    // Amending moves an order to its new price, and only to the back of the
+    // queue there when it gets a new price or more quantity.
+    pending.insert(Numbered<LimitOrder>(8, BUY, 1, 95));
+    ok = ok && pending.amend(1, 0.5, 95) && pending.amend(4, 2, 96) && !pending.amend(9, 1, 1);
+    const LimitOrder *amended = static_cast<const LimitOrder*>(pending.find(4));
+    ok = ok && amended && amended->price == 96 && amended->quantity == 2;
+    ok = ok && pending.resting() == std::vector<const Action*>{pending.find(1), amended, pending.find(8)};
+    filled.clear();
+    ok = ok && pending.trigger(95, fill) == 2 && filled == std::vector<int>{1, 8};
+    ok = ok && pending.trigger(96, fill) == 1 && filled.back() == 4 && pending.empty();
+    return ok ? 0 : 1;
+}
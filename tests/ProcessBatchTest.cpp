@@ -0,0 +1,47 @@
+#define Simulator() Simulator(); friend int ProcessBatchTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include "TestFixtures.h"
+#include <filesystem>
+
+int ProcessBatchTest(int argc, char* argv[]){
+    IdleModel model;
+    Simulator sim;
+    sim.logDirectory = (std::filesystem::temp_directory_path() / "revival-logs" / "").string();
+    sim.init(&model, Portfolio{1000, 0, 10, 0}, Simulator::ORDER_BOOK, 0, 0.001);
+    sim.setFillModel(Simulator::BOOK_DEPTH);
+    sim.tradePrice = 100;
+
+    OrderBook orderBook{1, TimePoint(1), {{99, 10}}, {{101, 10}}};
+    TradeColumns trades{Trade{1, 100, 1, TimePoint(1)}};
+    Simulator::Timestep ts(TimePoint(1), MarketHistory{trades}, orderBook);
+
+    // The first buy and sell have the limit order between them and walk the
+    // book on their own. The last two are crossed at 100, and what is left of
+    // the buy walks the asks.
+    int limitId = Simulator::nextActionId;
+    sim.actionBatch = {
+        MarketOrder(BUY, 1),
+        LimitOrder(BUY, 1, 90),
+        MarketOrder(SELL, 1),
+        Cancel(limitId),
+        MarketOrder(BUY, 2),
+        MarketOrder(SELL, 1)
+    };
+    sim.processBatch(ts);
+
+    double money = 1000;
+    double quantity = 10;
+    money -= 101; quantity += 0.999; // buy 1 at 101
+    money -= 90; // limit rests
+    quantity -= 1; money += 99 * 0.999; // sell 1 at 99
+    money += 90; // limit cancelled
+    money -= 100; quantity += 0.999; quantity -= 1; money += 100 * 0.999; // 1 crossed at 100
+    money -= 101; quantity += 0.999; // buy the other 1 at 101
+    bool ok = sim.actionBatch.empty() && near(sim.portfolio.authMoney, money) && near(sim.portfolio.authQuantity, quantity)
+        && near(sim.portfolio.pendingMoney, 0) && near(sim.portfolio.pendingQuantity, 0) && sim.pendingOrders.empty();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include "..\PendingOrders.h"
+#include "..\BookDepth.h"
+
+namespace {
+
+struct NumberedLimit : LimitOrder
+{
+    NumberedLimit(int id, ActionType actionType, double quantity, double price, double queueAhead) : LimitOrder(actionType, quantity, price){
+        this->actionId = id;
+        this->queueAhead = queueAhead;
+    }
+};
+
+}
+
+int QueuePositionTest(int argc, char* argv[]){
+    std::vector<Order> bids{{98, 4}, {99, 3}};
+    std::vector<Order> asks{{102, 6}, {101, 5}};
+    BookDepth depth;
+    depth.assign(1, TimePoint(1), bids, asks);
+    bool ok = depth.levelQuantity(BUY, 99) == 3 && depth.levelQuantity(BUY, 98) == 4
+        && depth.levelQuantity(SELL, 101) == 5 && depth.levelQuantity(SELL, 102) == 6
+        && depth.levelQuantity(BUY, 100) == 0 && depth.levelQuantity(SELL, 99) == 0;
+
+    PendingOrders pending;
+    pending.insert(NumberedLimit(1, BUY, 1, 99, depth.levelQuantity(BUY, 99)));
+    pending.insert(NumberedLimit(2, BUY, 1, 98, depth.levelQuantity(BUY, 98)));
+    pending.insert(NumberedLimit(3, SELL, 1, 101, depth.levelQuantity(SELL, 101)));
+
+    std::vector<int> filled;
+    std::vector<double> quantities;
+    auto fill = [&](const LimitOrder &lo, double quantity){
+        filled.push_back(lo.getId());
+        quantities.push_back(quantity);
+    };
+
+    // Trades at the limit first use up what was queued ahead. Buyer-maker
+    // trades hit the bids.
+    ok = ok && pending.match(Trade{1, 99, 2, TimePoint(2), true}, fill) == 0;
+    ok = ok && pending.match(Trade{2, 99, 1, TimePoint(3), true}, fill) == 0;
+    ok = ok && pending.match(Trade{3, 99, 0.5, TimePoint(4), true}, fill) == 1 && filled == std::vector<int>{1};
+
+    // What is left of a trade after the queue fills the order partially.
+    ok = ok && quantities == std::vector<double>{0.5} && pending.size() == 3
+        && static_cast<const LimitOrder*>(pending.find(1))->filled == 0.5;
+    ok = ok && pending.match(Trade{4, 99, 2, TimePoint(4), true}, fill) == 1 && quantities.back() == 0.5 && !pending.find(1);
+
+    // A trade through the limit fills whatever was ahead.
+    filled.clear();
+    ok = ok && pending.match(Trade{5, 97.5, 0.1, TimePoint(5)}, fill) == 1 && filled == std::vector<int>{2} && quantities.back() == 1;
+
+    // Trades away from the limit leave the queue alone.
+    filled.clear();
+    ok = ok && pending.match(Trade{6, 100, 9, TimePoint(6)}, fill) == 0;
+    ok = ok && pending.match(Trade{7, 101, 4, TimePoint(7)}, fill) == 0;
+    ok = ok && pending.match(Trade{8, 101, 2, TimePoint(8)}, fill) == 1 && filled == std::vector<int>{3};
+    ok = ok && pending.empty() && !pending.hasLimits();
+
+    // One trade is shared between our orders at its price, the earlier ones
+    // being queued ahead of the later ones, and only the side it hit trades.
+    filled.clear();
+    quantities.clear();
+    pending.insert(NumberedLimit(4, BUY, 1, 100, 0));
+    pending.insert(NumberedLimit(5, BUY, 1, 100, 0));
+    pending.insert(NumberedLimit(6, SELL, 1, 100, 0));
+    ok = ok && static_cast<const LimitOrder*>(pending.find(5))->queueAhead == 1;
+    ok = ok && pending.match(Trade{9, 100, 1, TimePoint(9), true}, fill) == 1
+        && filled == std::vector<int>{4} && quantities == std::vector<double>{1} && pending.size() == 2;
+    ok = ok && pending.match(Trade{10, 100, 1, TimePoint(10)}, fill) == 1 && filled.back() == 6;
+    ok = ok && pending.match(Trade{11, 100, 1, TimePoint(11), true}, fill) == 1 && filled.back() == 5 && pending.empty();
+
+    // An order leaving the queue lets the ones behind it move up.
+    pending.insert(NumberedLimit(7, SELL, 2, 101, 1));
+    pending.insert(NumberedLimit(8, SELL, 1, 101, 1));
+    ok = ok && static_cast<const LimitOrder*>(pending.find(8))->queueAhead == 3;
+    pending.erase(7);
+    ok = ok && static_cast<const LimitOrder*>(pending.find(8))->queueAhead == 1;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "..\Model.h"
+#include <cmath>
+#include <vector>
+
+// A model that never acts, for tests that drive the simulator themselves. Its
+// protected helpers are made public so a test can call them as a model would.
+class IdleModel : public Model
+{
+public:
+    using Model::make;
+    using Model::setWakeConditions;
+
+    std::vector<Action *> run(const Portfolio &portfolio, const std::vector<const Action*> &pendingActions,
+               const MarketHistory &market, const OrderBook &orderBook) override {
+        return {};
+    }
+};
+
+// Equal but for rounding, for money and quantities summed in another order.
+inline bool near(double a, double b){ return std::abs(a - b) < 1e-9; }
@@ -0,0 +1,36 @@
+#define Simulator() Simulator(); friend int TimestepIndexTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include <filesystem>
+#include <fstream>
+
+int TimestepIndexTest(int argc, char* argv[]){
+    Simulator sim;
+    sim.marketHistory = {
+        Trade{0, 1, 1, TimePoint(4)},
+        Trade{0, 2, 2, TimePoint(8)},
+        Trade{0, 3, 3, TimePoint(11)}
+    };
+    sim.orderBooks = {OrderBook{0, TimePoint(6)}, OrderBook{0, TimePoint(9)}};
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "revival-timesteps.bin";
+    if(!sim.writeTimestepIndex(path.string(), Simulator::BOTH))
+        return 1;
+
+    std::vector<Simulator::TimestepIndexEntry> index(std::filesystem::file_size(path) / sizeof(Simulator::TimestepIndexEntry));
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(index.data()), index.size() * sizeof(Simulator::TimestepIndexEntry));
+    std::filesystem::remove(path);
+
+    std::vector<Simulator::Timestep> ts = sim.getBothTimesteps();
+    bool ok = index.size() == ts.size() && index.size() == 5;
+    for(std::size_t i = 0; ok && i < index.size(); i++){
+        ok = index[i].time == std::get<0>(ts[i]).count()
+            && index[i].marketHistoryIndex == std::get<1>(ts[i]).trades.size()
+            && (index[i].orderBookIndex < 0 ? &std::get<2>(ts[i]) == &Simulator::initialOrderBook 
+                                            : &std::get<2>(ts[i]) == &sim.orderBooks[index[i].orderBookIndex]);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#define Simulator() Simulator(); friend int TradeColumnsTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include <algorithm>
+#include <ranges>
+
+int TradeColumnsTest(int argc, char* argv[]){
+    Simulator sim;
+
+    sim.marketHistory = {
+        Trade{1, 1, 4, TimePoint(4)},
+        Trade{2, 2, 3, TimePoint(8)},
+        Trade{3, 3, 2, TimePoint(11)},
+        Trade{4, 4, 1, TimePoint(12)},
+        Trade{5, 5, 0, TimePoint(13)}
+    };
+
+    MarketHistory market{TradeView(sim.marketHistory).first(3)};
+    double prices[]{1, 2, 3};
+    double quantities[]{4, 3, 2};
+    bool ok = market.prices().size() == 3 
+        && std::ranges::equal(market.prices(), prices)
+        && std::ranges::equal(market.quantities(), quantities)
+        && market.timestamps().back() == TimePoint(11)
+        && market.tradeIds().back() == 3;
+
+    ok = ok && sim.getPriceMean() == 3 && sim.getQuantityMean() == 2;
+
+    // The same trades read back whole, one at a time.
+    static_assert(std::ranges::random_access_range<TradeView>);
+    std::vector<Trade> firstTrades{Trade{1, 1, 4, TimePoint(4)}, Trade{2, 2, 3, TimePoint(8)}, Trade{3, 3, 2, TimePoint(11)}};
+    ok = ok && std::ranges::equal(market.trades, firstTrades) && market.trades.back() == firstTrades.back()
+        && market.trades.last(2).front().tradeId == 2 && sim.marketHistory[4] == Trade{5, 5, 0, TimePoint(13)};
+
+    // Sorting from a given trade on moves every column alike and keeps equal
+    // timestamps in order.
+    TradeColumns unsorted{
+        Trade{1, 10, 1, TimePoint(5)},
+        Trade{2, 20, 2, TimePoint(3)},
+        Trade{3, 30, 3, TimePoint(5)},
+        Trade{4, 40, 4, TimePoint(1)}
+    };
+    unsorted.sortByTime(1);
+    ok = ok && unsorted.tradeIds == std::vector<long long>{1, 4, 2, 3}
+        && unsorted.prices == std::vector<double>{10, 40, 20, 30}
+        && unsorted.quantities == std::vector<double>{1, 4, 2, 3}
+        && unsorted.timestamps == std::vector<TimePoint>{TimePoint(5), TimePoint(1), TimePoint(3), TimePoint(5)};
+    return ok ? 0 : 1;
+}
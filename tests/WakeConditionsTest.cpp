@@ -0,0 +1,45 @@
+#define Simulator() Simulator(); friend int WakeConditionsTest(int argc, char* argv[]);
+
+#include "..\Simulator.h"
+
+#undef Simulator
+
+#include "TestFixtures.h"
+
+int WakeConditionsTest(int argc, char* argv[]){
+    Simulator sim;
+    IdleModel model;
+    sim.model = &model;
+    sim.filledSinceRun = false;
+    sim.lastRunOrderBookId = 1;
+    sim.lastRunOrderBookTime = TimePoint(5);
+
+    TradeColumns trades{Trade{0, 100, 1, TimePoint(4)}};
+    OrderBook sameBook{1, TimePoint(5)};
+    OrderBook newBook{2, TimePoint(9)};
+    Simulator::Timestep quiet(TimePoint(10), MarketHistory{trades}, sameBook);
+    Simulator::Timestep booked(TimePoint(10), MarketHistory{trades}, newBook);
+
+    bool ok = sim.wakesModel(quiet);
+
+    model.setWakeConditions(WakeConditions{.everyTimestep = false});
+    ok = ok && !sim.wakesModel(quiet) && !sim.wakesModel(booked);
+
+    model.setWakeConditions(WakeConditions{.everyTimestep = false, .onOrderBook = true});
+    ok = ok && !sim.wakesModel(quiet) && sim.wakesModel(booked);
+
+    model.setWakeConditions(WakeConditions{.everyTimestep = false, .at = TimePoint(10)});
+    ok = ok && sim.wakesModel(quiet);
+
+    model.setWakeConditions(WakeConditions{.everyTimestep = false, .priceAtOrAbove = 101, .priceAtOrBelow = 99});
+    ok = ok && !sim.wakesModel(quiet);
+    model.setWakeConditions(WakeConditions{.everyTimestep = false, .priceAtOrAbove = 100});
+    ok = ok && sim.wakesModel(quiet);
+
+    model.setWakeConditions(WakeConditions{.everyTimestep = false, .onFill = true});
+    ok = ok && !sim.wakesModel(quiet);
+    sim.filledSinceRun = true;
+    ok = ok && sim.wakesModel(quiet);
+
+    return ok ? 0 : 1;
+}